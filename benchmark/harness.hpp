@@ -0,0 +1,218 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <sax/iostream.hpp>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#if defined( _MSC_VER )
+#    include <intrin.h>
+#endif
+
+// A minimal microbenchmark harness (in the spirit of Google Benchmark, without the dependency). A benchmark is a name,
+// the floating point operations and the bytes moved per op (estimates, 0 if not meaningful) and a callable doing one op.
+// The harness calibrates the number of ops per repetition to at least min_time seconds, and reports the fastest of the
+// repetitions in ns/op, GFLOP/s and bytes/op, on the console and (--json=<path>) as JSON:
+//
+//       benchmark_suite suite ( argc, argv );
+//       suite.add ( "dot_ps/256", 2 * 256, 8 * 256, [ & ] { do_not_optimize ( dot_ps ( a, b, 256 ) ); } );
+//       return suite.run ( );
+//
+// Arguments: --filter=<substring> runs the benchmarks with a name containing it, --min-time=<seconds> (0.1),
+// --repetitions=<n> (5), --json=<path> ('-' is stdout, the table then goes to stderr, so stdout is valid JSON).
+
+// keeps the compiler from optimizing away the computation of value_
+template<typename T>
+inline void do_not_optimize ( T const & value_ ) noexcept {
+#if defined( _MSC_VER )
+    static_cast<void> ( *static_cast<T const volatile *> ( &value_ ) );
+    _ReadWriteBarrier ( );
+#else
+    asm volatile( "" : : "r,m"( value_ ) : "memory" );
+#endif
+}
+
+// the memory pointed to by p_ is read and written (as far as the compiler knows)
+inline void clobber ( void * p_ ) noexcept {
+#if defined( _MSC_VER )
+    static_cast<void> ( p_ );
+    _ReadWriteBarrier ( );
+#else
+    asm volatile( "" : : "g"( p_ ) : "memory" );
+#endif
+}
+
+class benchmark_suite {
+
+    struct benchmark {
+        std::string name;
+        double flops, bytes; // per op
+        std::function<void ( )> op;
+    };
+
+    struct result {
+        std::string name;
+        std::int64_t iterations;
+        double ns, flops, bytes; // per op
+    };
+
+    public:
+    benchmark_suite ( int argc_, char ** argv_ ) {
+        for ( int a = 1; a < argc_; ++a ) {
+            std::string_view const arg = argv_[ a ];
+            if ( arg.starts_with ( "--filter=" ) )
+                m_filter = arg.substr ( 9 );
+            else if ( arg.starts_with ( "--min-time=" ) )
+                m_min_time = std::atof ( argv_[ a ] + 11 );
+            else if ( arg.starts_with ( "--repetitions=" ) )
+                m_repetitions = std::max ( 1, std::atoi ( argv_[ a ] + 14 ) );
+            else if ( arg.starts_with ( "--json=" ) )
+                m_json = arg.substr ( 7 );
+            else
+                std::cerr << "unknown argument " << arg << " (--filter=, --min-time=, --repetitions=, --json=)" << nl;
+        }
+    }
+
+    // context_ is a key and a value reported in the json output (f.e. the cpu)
+    void context ( std::string key_, std::string value_ ) { m_context.emplace_back ( std::move ( key_ ), std::move ( value_ ) ); }
+
+    template<typename Op>
+    void add ( std::string name_, double flops_, double bytes_, Op && op_ ) {
+        m_benchmarks.push_back ( { std::move ( name_ ), flops_, bytes_, std::forward<Op> ( op_ ) } );
+    }
+
+    // runs the (filtered) benchmarks, returns EXIT_SUCCESS, or EXIT_FAILURE if the json could not be written
+    [[nodiscard]] int run ( ) {
+        std::vector<result> results;
+        std::ostream & table = m_json == "-" ? std::cerr : std::cout;
+        table << std::left << std::setw ( 44 ) << "benchmark" << std::right << std::setw ( 14 ) << "iterations"
+              << std::setw ( 12 ) << "ns/op" << std::setw ( 10 ) << "GFLOP/s" << std::setw ( 12 ) << "bytes/op" << nl;
+        for ( auto & b : m_benchmarks ) {
+            if ( b.name.find ( m_filter ) == std::string::npos )
+                continue;
+            result const r = measure ( b );
+            table << std::left << std::setw ( 44 ) << r.name << std::right << std::setw ( 14 ) << r.iterations << std::fixed
+                  << std::setprecision ( 2 ) << std::setw ( 12 ) << r.ns << std::setprecision ( 3 ) << std::setw ( 10 );
+            if ( r.flops > 0.0 )
+                table << r.flops / r.ns;
+            else
+                table << "-";
+            table << std::setprecision ( 0 ) << std::setw ( 12 );
+            if ( r.bytes > 0.0 )
+                table << r.bytes << nl;
+            else
+                table << "-" << nl;
+            results.push_back ( r );
+        }
+        if ( m_json.empty ( ) )
+            return EXIT_SUCCESS;
+        std::string const json = to_json ( results );
+        if ( m_json == "-" ) {
+            std::cout << json;
+            return EXIT_SUCCESS;
+        }
+        std::ofstream stream ( m_json, std::ios::trunc );
+        stream << json;
+        if ( not stream.flush ( ) ) {
+            std::cerr << "cannot write " << m_json << nl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    private:
+    [[nodiscard]] result measure ( benchmark & b_ ) const {
+        using clock = std::chrono::steady_clock;
+        auto run    = [ &b_ ] ( std::int64_t n_ ) {
+            auto const t0 = clock::now ( );
+            for ( std::int64_t i = 0; i < n_; ++i )
+                b_.op ( );
+            return std::chrono::duration<double> ( clock::now ( ) - t0 ).count ( );
+        };
+        std::int64_t n = 1;
+        run ( n ); // warm up
+        for ( double t = run ( n ); t < m_min_time; t = run ( n ) )
+            n = t < m_min_time / 100.0 ? n * 10 : static_cast<std::int64_t> ( n * 1.5 * m_min_time / t ) + 1;
+        double best = std::numeric_limits<double>::max ( );
+        for ( int r = 0; r < m_repetitions; ++r )
+            best = std::min ( best, run ( n ) );
+        return { b_.name, n, best * 1e9 / n, b_.flops, b_.bytes };
+    }
+
+    [[nodiscard]] static std::string quoted ( std::string_view s_ ) {
+        std::string q = "\"";
+        for ( char const c : s_ ) {
+            if ( c == '"' or c == '\\' )
+                q += '\\';
+            if ( static_cast<unsigned char> ( c ) >= 0x20 )
+                q += c;
+        }
+        return q += '"';
+    }
+
+    [[nodiscard]] std::string to_json ( std::vector<result> const & results_ ) const {
+        std::ostringstream json;
+        json << std::setprecision ( 6 ) << "{\n  \"context\": {";
+        for ( std::size_t c = 0; c < m_context.size ( ); ++c )
+            json << ( c ? ",\n    " : "\n    " ) << quoted ( m_context[ c ].first ) << ": " << quoted ( m_context[ c ].second );
+        json << "\n  },\n  \"benchmarks\": [";
+        for ( std::size_t r = 0; r < results_.size ( ); ++r ) {
+            auto const & b = results_[ r ];
+            json << ( r ? ",\n    " : "\n    " ) << "{ \"name\": " << quoted ( b.name ) << ", \"iterations\": " << b.iterations
+                 << ", \"ns_per_op\": " << b.ns << ", \"gflops\": ";
+            if ( b.flops > 0.0 )
+                json << b.flops / b.ns;
+            else
+                json << "null";
+            json << ", \"bytes_per_op\": ";
+            if ( b.bytes > 0.0 )
+                json << b.bytes;
+            else
+                json << "null";
+            json << " }";
+        }
+        json << "\n  ]\n}\n";
+        return json.str ( );
+    }
+
+    std::vector<benchmark> m_benchmarks;
+    std::vector<std::pair<std::string, std::string>> m_context;
+    std::string m_filter, m_json;
+    double m_min_time = 0.1;
+    int m_repetitions = 5;
+};
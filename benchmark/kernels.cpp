@@ -0,0 +1,263 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// Microbenchmarks of the core kernels: the forward pass over a range of network sizes and over the activations, the
+// batched forward kernels, the level-1 kernels, feed_forward_soft_max, the vectorized exp against std::exp and powf, a
+// ring_span push and pop, and a td_lambda step. See harness.hpp for the arguments, f.e. to track regressions:
+//
+//       kernels --json=kernels.json
+//
+// The flops and bytes per op are estimates from the algorithm, not counters: a forward pass is a multiply-add per weight
+// and reads the weights and the scratch space once; transcendentals (exp, powf) count as one flop.
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+
+#include <array>
+#include <memory>
+#include <sax/iostream.hpp>
+#include <string>
+#include <vector>
+
+#include <sax/prng_sfc.hpp>
+
+#include "benchmark/harness.hpp"
+#include "include/activation.hpp"
+#include "include/cascade_network.hpp"
+#include "include/td_lambda.hpp"
+#include "include/td_learning/concurrent_ring_span.hpp"
+#include "include/td_learning/cpu_features.hpp"
+#include "include/td_learning/ring_span.hpp"
+#include "include/td_learning/simd_sfc.hpp"
+
+template<typename Network>
+[[nodiscard]] std::string shape_name ( ) {
+    std::string name;
+    for ( auto const s : Network::shape )
+        name += ( name.empty ( ) ? "<" : "," ) + std::to_string ( s );
+    return name + ">";
+}
+
+// flops and bytes of one forward pass
+template<typename Network>
+inline constexpr double forward_flops = 2.0 * Network::NumWeights + Network::shape[ 3 ];
+template<typename Network>
+inline constexpr double forward_bytes = 4.0 * ( Network::NumWeights + Network::NumInpHidOut );
+
+template<typename Network>
+void add_feed_forward ( benchmark_suite & suite_, sax::Rng & rng_, std::string name_ ) {
+    auto net = std::make_shared<Network> ( rng_ );
+    simd_sfc32 ( rng_ ( ) ).fill_uniform ( net->space.raw ( ).data ( ), Network::NumRaw, -1.0f, 1.0f );
+    suite_.add ( std::move ( name_ ), forward_flops<Network>, forward_bytes<Network>, [ net ] {
+        net->feed_forward ( );
+        clobber ( net->space.data ( ) );
+    } );
+}
+
+template<typename Network>
+void add_feed_forward ( benchmark_suite & suite_, sax::Rng & rng_ ) {
+    add_feed_forward<Network> ( suite_, rng_, "feed_forward" + shape_name<Network> ( ) );
+}
+
+template<typename Hidden, typename Output = activation::rectifier>
+void add_activation ( benchmark_suite & suite_, sax::Rng & rng_ ) {
+    using network = cascade_network<64, 1, 4, 64, Hidden, Output>;
+    add_feed_forward<network> ( suite_, rng_,
+                                "feed_forward" + shape_name<network> ( ) + "/" + std::string ( Hidden::name ) + "/" +
+                                    std::string ( Output::name ) );
+}
+
+template<typename Network>
+void add_batch_forward ( benchmark_suite & suite_, sax::Rng & rng_, int batch_size_ ) {
+    auto net   = std::make_shared<Network> ( rng_ );
+    auto batch = std::make_shared<typename Network::batch_type> ( batch_size_ );
+    simd_sfc32 fill ( rng_ ( ) );
+    for ( int r = 0; r < batch_size_; ++r )
+        fill.fill_uniform ( batch->raw ( r ).data ( ), Network::NumRaw, -1.0f, 1.0f );
+    for ( int k = 0; k < static_cast<int> ( std::size ( forward_kernel_names ) ); ++k )
+        suite_.add ( "batch_forward" + shape_name<Network> ( ) + "/" + std::string ( forward_kernel_names[ k ] ) + "/" +
+                         std::to_string ( batch_size_ ),
+                     batch_size_ * forward_flops<Network>, batch_size_ * forward_bytes<Network>, [ net, batch, k ] {
+                         net->feed_forward ( *batch, net->weights.data ( ), static_cast<forward_kernel> ( k ) );
+                         clobber ( batch->data ( 0 ) );
+                     } );
+}
+
+void add_level1 ( benchmark_suite & suite_, int n_ ) {
+    auto x = std::make_shared<aligned_vector<float>> ( n_, 0.5f ), y = std::make_shared<aligned_vector<float>> ( n_, 0.25f );
+    std::string const n = "/" + std::to_string ( n_ );
+    suite_.add ( "dot_ps" + n, 2.0 * n_, 8.0 * n_, [ x, y, n_ ] { do_not_optimize ( dot_ps ( x->data ( ), y->data ( ), n_ ) ); } );
+    suite_.add ( "axpy_ps" + n, 2.0 * n_, 12.0 * n_, [ x, y, n_ ] {
+        axpy_ps ( y->data ( ), 1e-9f, x->data ( ), n_ );
+        clobber ( y->data ( ) );
+    } );
+    suite_.add ( "scale_ps" + n, 1.0 * n_, 8.0 * n_, [ x, n_ ] {
+        scale_ps ( x->data ( ), 1.0f, n_ );
+        clobber ( x->data ( ) );
+    } );
+}
+
+void add_soft_max ( benchmark_suite & suite_, sax::Rng & rng_ ) {
+    using network = cascade_network<64, 1, 16, 64>;
+    auto net      = std::make_shared<network> ( rng_ );
+    std::array<float, network::NumOut> out;
+    simd_sfc32 ( rng_ ( ) ).fill_uniform ( out.data ( ), out.size ( ), -4.0f, 4.0f );
+    // restores the outputs (a copy of 64 bytes) on every op, feed_forward_soft_max works in place
+    suite_.add ( "feed_forward_soft_max" + shape_name<network> ( ), 5.0 * network::NumOut, 8.0 * network::NumOut, [ net, out ] {
+        std::copy ( std::begin ( out ), std::end ( out ), std::begin ( net->space.out ( ) ) );
+        net->feed_forward_soft_max ( );
+        clobber ( net->space.data ( ) );
+    } );
+}
+
+void add_exp ( benchmark_suite & suite_ ) {
+    constexpr int n = 1'024;
+    auto x          = std::make_shared<aligned_vector<float>> ( n ), y = std::make_shared<aligned_vector<float>> ( n );
+    simd_sfc32 ( 1 ).fill_uniform ( x->data ( ), n, -10.0f, 10.0f );
+    auto add = [ & ] ( std::string name_, auto f_ ) {
+        suite_.add ( "exp/" + name_ + "/1024", n, 8.0 * n, [ x, y, f_ ] {
+            f_ ( x->data ( ), y->data ( ) );
+            clobber ( y->data ( ) );
+        } );
+    };
+    add ( "std::exp", [ ] ( float const * x_, float * y_ ) noexcept {
+        for ( int i = 0; i < n; ++i )
+            y_[ i ] = std::exp ( x_[ i ] );
+    } );
+    add ( "powf", [ ] ( float const * x_, float * y_ ) noexcept {
+        for ( int i = 0; i < n; ++i )
+            y_[ i ] = std::pow ( euler_constant_ps, x_[ i ] );
+    } );
+#if defined( __AVX2__ )
+    add ( "_mm256_exp_ps", [ ] ( float const * x_, float * y_ ) noexcept {
+        for ( int i = 0; i < n; i += 8 )
+            _mm256_store_ps ( y_ + i, _mm256_exp_ps ( _mm256_load_ps ( x_ + i ) ) );
+    } );
+    using ops = detail::simd_ops<__m256>;
+#else
+    using ops = detail::simd_ops<__m128>;
+#endif
+    add ( "exp_ps<fast>", [ ] ( float const * x_, float * y_ ) noexcept {
+        for ( int i = 0; i < n; i += ops::width )
+            ops::storeu ( y_ + i, exp_ps<simd_accuracy::fast> ( ops::loadu ( x_ + i ) ) );
+    } );
+    add ( "exp_ps<medium>", [ ] ( float const * x_, float * y_ ) noexcept {
+        for ( int i = 0; i < n; i += ops::width )
+            ops::storeu ( y_ + i, exp_ps<simd_accuracy::medium> ( ops::loadu ( x_ + i ) ) );
+    } );
+    add ( "exp_ps<accurate>", [ ] ( float const * x_, float * y_ ) noexcept {
+        for ( int i = 0; i < n; i += ops::width )
+            ops::storeu ( y_ + i, exp_ps<simd_accuracy::accurate> ( ops::loadu ( x_ + i ) ) );
+    } );
+#if defined( __AVX512F__ )
+    add ( "exp_ps<medium>x16", [ ] ( float const * x_, float * y_ ) noexcept {
+        for ( int i = 0; i < n; i += 16 )
+            _mm512_store_ps ( y_ + i, exp_ps<simd_accuracy::medium> ( _mm512_load_ps ( x_ + i ) ) );
+    } );
+#endif
+}
+
+void add_ring_span ( benchmark_suite & suite_ ) {
+    // half full, so that the push and the pop of an op never see a full or an empty ring, each ring on its own storage
+    auto storage = std::make_shared<std::array<float, 1'024>> ( );
+    auto ring    = std::make_shared<nonstd::ring_span<float>> ( std::begin ( *storage ), std::end ( *storage ) );
+    for ( int i = 0; i < 512; ++i )
+        ring->push_back ( static_cast<float> ( i ) );
+    suite_.add ( "ring_span/push_back+pop_front", 0.0, 8.0, [ storage, ring ] {
+        ring->push_back ( 1.0f );
+        do_not_optimize ( ring->pop_front ( ) );
+    } );
+    auto spsc_storage = std::make_shared<std::array<float, 1'024>> ( );
+    auto spsc         = std::make_shared<spsc_ring_span<float>> ( std::begin ( *spsc_storage ), std::end ( *spsc_storage ) );
+    for ( int i = 0; i < 512; ++i )
+        static_cast<void> ( spsc->push_back ( static_cast<float> ( i ) ) );
+    suite_.add ( "spsc_ring_span/push_back+pop_front", 0.0, 8.0, [ spsc_storage, spsc ] {
+        float v;
+        do_not_optimize ( spsc->push_back ( 1.0f ) );
+        do_not_optimize ( spsc->pop_front ( v ) );
+        do_not_optimize ( v );
+    } );
+}
+
+// a step is two forward passes, a trace update (scale and gradient) and a learning step (axpy) per output
+template<typename Network>
+void add_td_step ( benchmark_suite & suite_, sax::Rng & rng_ ) {
+    constexpr double w = Network::NumWeights, k = Network::NumOut;
+    struct state {
+        Network network;
+        td_lambda<Network> learner;
+        aligned_vector<float> observations;
+        std::array<float, Network::NumOut> reward { };
+        int t = 0;
+        state ( sax::Rng & rng_ ) :
+            network ( rng_ ), learner ( network, { .learning_rate = 1e-4f } ), observations ( 1'024 * Network::NumRaw ) {
+            simd_sfc32 ( rng_ ( ) ).fill_uniform ( observations.data ( ), observations.size ( ), -1.0f, 1.0f );
+        }
+    };
+    auto s = std::make_shared<state> ( rng_ );
+    suite_.add ( "td_lambda/step" + shape_name<Network> ( ), w * ( 4.0 + 5.0 * k ), 4.0 * w * ( 2.0 + 7.0 * k ), [ s ] {
+        float const * o = s->observations.data ( ) + ( s->t++ & 1'023 ) * Network::NumRaw;
+        do_not_optimize ( s->learner.step ( { o, Network::NumRaw }, s->reward ) );
+    } );
+}
+
+int main ( int argc, char ** argv ) {
+
+    sax::Rng rng ( sax::fixed_seed ( ) );
+
+    benchmark_suite suite ( argc, argv );
+    suite.context ( "cpu", cpu_features::detect ( ).brand );
+    suite.context ( "simd", TD_LEARNING_TARGET_NAME ); // of the flags the benchmark is compiled with
+    suite.context ( "simd_alignment", std::to_string ( calc::simd_alignment ) );
+
+    add_feed_forward<cascade_network<2, 1, 3, 5>> ( suite, rng );
+    add_feed_forward<cascade_network<8, 1, 2, 8>> ( suite, rng );
+    add_feed_forward<cascade_network<32, 1, 4, 32>> ( suite, rng );
+    add_feed_forward<cascade_network<64, 1, 4, 64>> ( suite, rng );
+    add_feed_forward<cascade_network<128, 1, 8, 128>> ( suite, rng );
+    add_feed_forward<cascade_network<256, 1, 16, 256>> ( suite, rng );
+
+    add_activation<activation::identity> ( suite, rng );
+    add_activation<activation::rectifier> ( suite, rng );
+    add_activation<activation::leaky_rectifier> ( suite, rng );
+    add_activation<activation::elliott> ( suite, rng );
+    add_activation<activation::logistic> ( suite, rng );
+    add_activation<activation::tanh> ( suite, rng );
+    add_activation<activation::rectifier, activation::softmax> ( suite, rng );
+
+    add_batch_forward<cascade_network<64, 1, 4, 64>> ( suite, rng, 64 );
+
+    add_level1 ( suite, 100 );
+    add_level1 ( suite, 4'096 );
+
+    add_soft_max ( suite, rng );
+    add_exp ( suite );
+    add_ring_span ( suite );
+
+    add_td_step<cascade_network<8, 1, 2, 8>> ( suite, rng );
+    add_td_step<cascade_network<64, 1, 4, 64>> ( suite, rng );
+
+    return suite.run ( );
+}
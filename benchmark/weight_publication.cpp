@@ -0,0 +1,105 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Inference latency (p50/p99/p99.9) of a serving thread reading published weights, with the trainer idle and with the
+// trainer publishing new snapshots as fast as it can. Both runs should report the same percentiles.
+
+#include <cstdint>
+#include <cstdlib>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <sax/iostream.hpp>
+#include <thread>
+#include <vector>
+
+#include <sax/prng_sfc.hpp>
+
+#include "include/cascade_network.hpp"
+#include "include/td_learning/triple_buffer.hpp"
+
+using network = cascade_network<64, 1, 4, 64>;
+
+struct percentiles {
+    std::int64_t p50, p99, p999;
+};
+
+[[nodiscard]] percentiles serve ( network & served_, triple_buffer<network::wgt_type> & store_, int samples_ ) noexcept {
+    std::vector<std::int64_t> latency ( samples_ );
+    for ( auto & l : latency ) {
+        auto const t0 = std::chrono::steady_clock::now ( );
+        served_.feed_forward ( store_.acquire ( ).data ( ) );
+        l = std::chrono::duration_cast<std::chrono::nanoseconds> ( std::chrono::steady_clock::now ( ) - t0 ).count ( );
+    }
+    auto nth = [ &latency ] ( double p_ ) noexcept {
+        auto i = std::next ( std::begin ( latency ), static_cast<std::ptrdiff_t> ( p_ * ( latency.size ( ) - 1 ) ) );
+        std::nth_element ( std::begin ( latency ), i, std::end ( latency ) );
+        return *i;
+    };
+    return { nth ( 0.5 ), nth ( 0.99 ), nth ( 0.999 ) };
+}
+
+template<typename Stream>
+Stream & operator<< ( Stream & out_, percentiles const & p_ ) noexcept {
+    out_ << "p50 " << p_.p50 << " ns, p99 " << p_.p99 << " ns, p99.9 " << p_.p999 << " ns";
+    return out_;
+}
+
+int main ( ) {
+
+    sax::Rng rng ( sax::fixed_seed ( ) );
+
+    constexpr int samples = 1'000'000;
+
+    network trainer ( rng ), served ( rng );
+    triple_buffer<network::wgt_type> store ( trainer.weights );
+
+    served.space.clear_scratch_space ( ); // the biases
+    std::uniform_real_distribution<float> input ( -1.0f, 1.0f );
+    for ( auto & r : served.space.raw ( ) )
+        r = input ( rng );
+
+    std::cout << "trainer idle    : " << serve ( served, store, samples ) << nl;
+
+    std::atomic<bool> stop = false;
+    std::int64_t published = 0;
+    std::thread training ( [ & ] ( ) noexcept {
+        while ( not stop.load ( std::memory_order_relaxed ) ) {
+            for ( auto & w : trainer.weights ) // stand-in for an update step
+                w *= 0.999'999f;
+            store.publish ( trainer.weights );
+            ++published;
+        }
+    } );
+
+    std::cout << "trainer running : " << serve ( served, store, samples ) << nl;
+
+    stop = true;
+    training.join ( );
+
+    std::cout << "snapshots published " << published << nl;
+
+    return EXIT_SUCCESS;
+}
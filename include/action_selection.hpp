@@ -0,0 +1,293 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <immintrin.h>
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+#include "td_learning/detail/simd_exp.inl"
+#include "td_learning/detail/simd_reduce.inl"
+#include "td_learning/rng.hpp"
+#include "td_learning/simd_sfc.hpp"
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+// Action selection over the outputs (action values) of a network, f.e. scratch_space::out ( ).data ( ). The values are read
+// 8 (4 with SSE4.1) at a time, so q_ must be readable up to n_ rounded up to a multiple of 8 (the out arrays are AVX
+// ready), the padding lanes are masked off (their content does not matter). Ties resolve to the lowest index. NaN values
+// are masked off like the padding, they are never selected; if no value is selectable (all NaN, or all -inf) the result
+// is 0.
+
+namespace detail {
+
+#if defined( __AVX2__ )
+
+// lanes [ n_, 8 ) of the chunk starting at i_ and the NaN lanes are masked off (replaced by fill_)
+[[nodiscard]] inline __m256 load_masked_ps ( float const * q_, int i_, int n_, __m256 fill_ ) noexcept {
+    __m256i const lane = _mm256_add_epi32 ( _mm256_set1_epi32 ( i_ ), _mm256_setr_epi32 ( 0, 1, 2, 3, 4, 5, 6, 7 ) );
+    __m256 const q     = _mm256_loadu_ps ( q_ + i_ );
+    __m256 const keep  = _mm256_and_ps ( _mm256_castsi256_ps ( _mm256_cmpgt_epi32 ( _mm256_set1_epi32 ( n_ ), lane ) ),
+                                        _mm256_cmp_ps ( q, q, _CMP_ORD_Q ) );
+    return _mm256_blendv_ps ( fill_, q, keep );
+}
+
+[[nodiscard]] inline __m256 nan_ps ( ) noexcept { return _mm256_set1_ps ( std::numeric_limits<float>::quiet_NaN ( ) ); }
+
+[[nodiscard]] inline __m256 minus_infinity_ps ( ) noexcept { return _mm256_set1_ps ( -std::numeric_limits<float>::infinity ( ) ); }
+[[nodiscard]] inline __m256 plus_infinity_ps ( ) noexcept { return _mm256_set1_ps ( std::numeric_limits<float>::infinity ( ) ); }
+
+#else
+
+[[nodiscard]] inline __m128 load_masked_ps ( float const * q_, int i_, int n_, __m128 fill_ ) noexcept {
+    __m128i const lane = _mm_add_epi32 ( _mm_set1_epi32 ( i_ ), _mm_setr_epi32 ( 0, 1, 2, 3 ) );
+    __m128 const q     = _mm_loadu_ps ( q_ + i_ );
+    __m128 const keep =
+        _mm_and_ps ( _mm_castsi128_ps ( _mm_cmpgt_epi32 ( _mm_set1_epi32 ( n_ ), lane ) ), _mm_cmpord_ps ( q, q ) );
+    return _mm_blendv_ps ( fill_, q, keep );
+}
+
+[[nodiscard]] inline __m128 nan_ps ( ) noexcept { return _mm_set1_ps ( std::numeric_limits<float>::quiet_NaN ( ) ); }
+
+[[nodiscard]] inline __m128 minus_infinity_ps ( ) noexcept { return _mm_set1_ps ( -std::numeric_limits<float>::infinity ( ) ); }
+[[nodiscard]] inline __m128 plus_infinity_ps ( ) noexcept { return _mm_set1_ps ( std::numeric_limits<float>::infinity ( ) ); }
+
+#endif
+
+} // namespace detail
+
+// uniform_batch
+//
+//   Uniform floats in [ 0, 1 ) (24 bits each), drawn in batches of 64 from a 64-bit generator (by default the thread-local
+//   sfc Rng::generator ( )), two floats per draw, or from the batch interface of a philox_stream.
+//
+template<typename Generator = sax::Rng>
+class uniform_batch {
+
+    static constexpr int size = 64;
+
+    public:
+    explicit uniform_batch ( Generator & rng_ = Rng::generator ( ) ) noexcept : m_rng ( rng_ ) {}
+
+    [[nodiscard]] float operator( ) ( ) noexcept {
+        if ( m_i == size )
+            refill ( );
+        return m_values[ m_i++ ];
+    }
+
+    // drops the buffered values (f.e. after re-keying the generator)
+    void reset ( ) noexcept { m_i = size; }
+
+    private:
+    void refill ( ) noexcept {
+        m_i = 0;
+        if constexpr ( requires { m_rng.uniforms ( m_values ); } ) {
+            for ( int i = 0; i < size; i += Generator::batch_size )
+                m_rng.uniforms ( m_values + i );
+        }
+        else {
+            alignas ( 32 ) std::uint64_t bits[ size / 2 ];
+            for ( auto & b : bits )
+                b = static_cast<std::uint64_t> ( m_rng ( ) );
+            for ( int i = 0; i < size / 2; ++i ) { // vectorizes
+                m_values[ 2 * i ]     = static_cast<float> ( bits[ i ] >> 40 ) * 0x1.0p-24f;
+                m_values[ 2 * i + 1 ] = static_cast<float> ( ( bits[ i ] >> 8 ) & 0xFF'FFFF ) * 0x1.0p-24f;
+            }
+        }
+    }
+
+    Generator & m_rng;
+    alignas ( 32 ) float m_values[ size ];
+    int m_i = size;
+};
+
+// index of the largest of the n_ values at q_.
+[[nodiscard]] inline int select_greedy ( float const * q_, int n_ ) noexcept {
+#if defined( __AVX2__ )
+    __m256 m = detail::load_masked_ps ( q_, 0, n_, detail::minus_infinity_ps ( ) );
+    for ( int i = 8; i < n_; i += 8 )
+        m = _mm256_max_ps ( m, detail::load_masked_ps ( q_, i, n_, detail::minus_infinity_ps ( ) ) );
+    __m256 const max = _mm256_set1_ps ( _mm256_hmax_ps ( m ) );
+    for ( int i = 0; i < n_; i += 8 ) // the masked lanes are NaN, they never compare equal
+        if ( int const hits = _mm256_movemask_ps (
+                 _mm256_cmp_ps ( detail::load_masked_ps ( q_, i, n_, detail::nan_ps ( ) ), max, _CMP_EQ_OQ ) ) )
+            return i + std::countr_zero ( static_cast<unsigned> ( hits ) );
+#else
+    __m128 m = detail::load_masked_ps ( q_, 0, n_, detail::minus_infinity_ps ( ) );
+    for ( int i = 4; i < n_; i += 4 )
+        m = _mm_max_ps ( m, detail::load_masked_ps ( q_, i, n_, detail::minus_infinity_ps ( ) ) );
+    __m128 const max = _mm_set1_ps ( _mm_hmax_ps ( m ) );
+    for ( int i = 0; i < n_; i += 4 )
+        if ( int const hits = _mm_movemask_ps ( _mm_cmpeq_ps ( detail::load_masked_ps ( q_, i, n_, detail::nan_ps ( ) ), max ) ) )
+            return i + std::countr_zero ( static_cast<unsigned> ( hits ) );
+#endif
+    return 0; // all NaN
+}
+
+// as select_greedy ( ), on values quantized to 16 bits (relative to the range of the values), using _mm_minpos_epu16 per 8
+// values. Values closer than ( max - min ) / 65535 tie.
+[[nodiscard]] inline int select_greedy_quantized ( float const * q_, int n_ ) noexcept {
+#if defined( __AVX2__ )
+    __m256 lo = detail::load_masked_ps ( q_, 0, n_, detail::plus_infinity_ps ( ) );
+    __m256 hi = detail::load_masked_ps ( q_, 0, n_, detail::minus_infinity_ps ( ) );
+    for ( int i = 8; i < n_; i += 8 ) {
+        lo = _mm256_min_ps ( lo, detail::load_masked_ps ( q_, i, n_, detail::plus_infinity_ps ( ) ) );
+        hi = _mm256_max_ps ( hi, detail::load_masked_ps ( q_, i, n_, detail::minus_infinity_ps ( ) ) );
+    }
+    float const max = _mm256_hmax_ps ( hi ), min = -_mm256_hmax_ps ( _mm256_sub_ps ( _mm256_setzero_ps ( ), lo ) );
+    __m256 const top = _mm256_set1_ps ( max ), scale = _mm256_set1_ps ( max > min ? 65'535.0f / ( max - min ) : 0.0f );
+    std::uint32_t best = std::numeric_limits<std::uint32_t>::max ( ); // key << 16 | index
+    for ( int i = 0; i < n_; i += 8 ) {
+        // key = ( max - q ) * scale, the largest value gets key 0, the masked lanes get key 65535 (also if all values tie)
+        __m256 const q    = detail::load_masked_ps ( q_, i, n_, detail::nan_ps ( ) );
+        __m256i const k32 = _mm256_blendv_epi8 ( _mm256_set1_epi32 ( 65'535 ),
+                                                 _mm256_cvtps_epi32 ( _mm256_mul_ps ( _mm256_sub_ps ( top, q ), scale ) ),
+                                                 _mm256_castps_si256 ( _mm256_cmp_ps ( q, q, _CMP_ORD_Q ) ) );
+        __m128i const k16 = _mm_packus_epi32 ( _mm256_castsi256_si128 ( k32 ), _mm256_extracti128_si256 ( k32, 1 ) );
+        __m128i const mp  = _mm_minpos_epu16 ( k16 );
+        std::uint32_t const key = static_cast<std::uint32_t> ( _mm_extract_epi16 ( mp, 0 ) ) << 16 |
+                                  static_cast<std::uint32_t> ( i + _mm_extract_epi16 ( mp, 1 ) );
+        best = std::min ( best, key );
+    }
+#else
+    __m128 lo = detail::load_masked_ps ( q_, 0, n_, detail::plus_infinity_ps ( ) );
+    __m128 hi = detail::load_masked_ps ( q_, 0, n_, detail::minus_infinity_ps ( ) );
+    for ( int i = 4; i < n_; i += 4 ) {
+        lo = _mm_min_ps ( lo, detail::load_masked_ps ( q_, i, n_, detail::plus_infinity_ps ( ) ) );
+        hi = _mm_max_ps ( hi, detail::load_masked_ps ( q_, i, n_, detail::minus_infinity_ps ( ) ) );
+    }
+    float const max = _mm_hmax_ps ( hi ), min = -_mm_hmax_ps ( _mm_sub_ps ( _mm_setzero_ps ( ), lo ) );
+    __m128 const top = _mm_set1_ps ( max ), scale = _mm_set1_ps ( max > min ? 65'535.0f / ( max - min ) : 0.0f );
+    auto const keys  = [ & ] ( int i_ ) noexcept { // of the 4 values at i_, as above
+        __m128 const q = detail::load_masked_ps ( q_, i_, n_, detail::nan_ps ( ) );
+        return _mm_blendv_epi8 ( _mm_set1_epi32 ( 65'535 ), _mm_cvtps_epi32 ( _mm_mul_ps ( _mm_sub_ps ( top, q ), scale ) ),
+                                 _mm_castps_si128 ( _mm_cmpord_ps ( q, q ) ) );
+    };
+    std::uint32_t best = std::numeric_limits<std::uint32_t>::max ( );
+    for ( int i = 0; i < n_; i += 8 ) { // 8 values, the second 4 may be past n_ (readable, masked)
+        __m128i const mp        = _mm_minpos_epu16 ( _mm_packus_epi32 ( keys ( i ), keys ( i + 4 ) ) );
+        std::uint32_t const key = static_cast<std::uint32_t> ( _mm_extract_epi16 ( mp, 0 ) ) << 16 |
+                                  static_cast<std::uint32_t> ( i + _mm_extract_epi16 ( mp, 1 ) );
+        best = std::min ( best, key );
+    }
+#endif
+    return static_cast<int> ( best & 0xFFFF );
+}
+
+// with probability epsilon_ a uniformly random action, otherwise the greedy one.
+template<typename Uniform>
+[[nodiscard]] int select_epsilon_greedy ( float const * q_, int n_, float epsilon_, Uniform & uniform_ ) noexcept {
+    int const greedy = select_greedy ( q_, n_ );
+    float const u    = uniform_ ( );
+    int const random = std::min ( static_cast<int> ( uniform_ ( ) * static_cast<float> ( n_ ) ), n_ - 1 );
+    return u < epsilon_ ? random : greedy; // cmov
+}
+
+// Boltzmann (softmax) exploration, action i with probability exp ( q_i / temperature_ ) / sum_j exp ( q_j / temperature_ ),
+// by inverse transform: the number of (per vector prefix summed) cumulative weights below u * sum.
+template<typename Uniform>
+[[nodiscard]] int select_boltzmann ( float const * q_, int n_, float temperature_, Uniform & uniform_ ) noexcept {
+    constexpr int max_chunks = 16; // up to 128 actions
+    assert ( n_ <= 8 * max_chunks );
+    alignas ( 32 ) float cdf[ 8 * max_chunks ];
+#if defined( __AVX2__ )
+    __m256 m = detail::load_masked_ps ( q_, 0, n_, detail::minus_infinity_ps ( ) );
+    for ( int i = 8; i < n_; i += 8 )
+        m = _mm256_max_ps ( m, detail::load_masked_ps ( q_, i, n_, detail::minus_infinity_ps ( ) ) );
+    float const top = _mm256_hmax_ps ( m );
+    if ( not ( top > -std::numeric_limits<float>::infinity ( ) ) )
+        return 0; // nothing to select (all NaN or -inf)
+    __m256 const max = _mm256_set1_ps ( top ), inverse = _mm256_set1_ps ( 1.0f / temperature_ );
+    float carry = 0.0f;
+    for ( int i = 0; i < n_; i += 8 ) {
+        // p = exp ( ( q - max ) / t ), 0 in the lanes past n_, the NaN lanes and the -inf lanes
+        __m256 const q = detail::load_masked_ps ( q_, i, n_, detail::minus_infinity_ps ( ) );
+        __m256 const x = _mm256_mul_ps ( _mm256_sub_ps ( q, max ), inverse );
+        __m256 p       = exp_ps ( x, _mm256_cmp_ps ( q, detail::minus_infinity_ps ( ), _CMP_GT_OQ ) ); // exactly 0 at -inf
+        // inclusive prefix sum within the 128-bit halves, then across
+        p          = _mm256_add_ps ( p, _mm256_castsi256_ps ( _mm256_slli_si256 ( _mm256_castps_si256 ( p ), 4 ) ) );
+        p          = _mm256_add_ps ( p, _mm256_castsi256_ps ( _mm256_slli_si256 ( _mm256_castps_si256 ( p ), 8 ) ) );
+        __m256 lo  = _mm256_permute2f128_ps ( p, p, 0x08 ); // [ 0, lo ]
+        lo         = _mm256_permute_ps ( lo, 0xFF );        // broadcast the sum of the low half into the high half
+        p          = _mm256_add_ps ( _mm256_add_ps ( p, lo ), _mm256_set1_ps ( carry ) );
+        _mm256_store_ps ( cdf + i, p );
+        carry = cdf[ i + 7 ];
+    }
+    __m256 const threshold = _mm256_set1_ps ( uniform_ ( ) * carry );
+    int below              = 0;
+    for ( int i = 0; i < n_; i += 8 )
+        below += std::popcount ( static_cast<unsigned> (
+            _mm256_movemask_ps ( _mm256_cmp_ps ( _mm256_load_ps ( cdf + i ), threshold, _CMP_LE_OQ ) ) ) );
+#else
+    __m128 m = detail::load_masked_ps ( q_, 0, n_, detail::minus_infinity_ps ( ) );
+    for ( int i = 4; i < n_; i += 4 )
+        m = _mm_max_ps ( m, detail::load_masked_ps ( q_, i, n_, detail::minus_infinity_ps ( ) ) );
+    float const top = _mm_hmax_ps ( m );
+    if ( not ( top > -std::numeric_limits<float>::infinity ( ) ) )
+        return 0;
+    __m128 const max = _mm_set1_ps ( top ), inverse = _mm_set1_ps ( 1.0f / temperature_ );
+    float carry = 0.0f;
+    for ( int i = 0; i < n_; i += 4 ) {
+        __m128 const q = detail::load_masked_ps ( q_, i, n_, detail::minus_infinity_ps ( ) );
+        __m128 const x = _mm_mul_ps ( _mm_sub_ps ( q, max ), inverse );
+        __m128 p       = exp_ps ( x, _mm_cmpgt_ps ( q, detail::minus_infinity_ps ( ) ) );
+        p              = _mm_add_ps ( p, _mm_castsi128_ps ( _mm_slli_si128 ( _mm_castps_si128 ( p ), 4 ) ) );
+        p              = _mm_add_ps ( p, _mm_castsi128_ps ( _mm_slli_si128 ( _mm_castps_si128 ( p ), 8 ) ) );
+        _mm_store_ps ( cdf + i, _mm_add_ps ( p, _mm_set1_ps ( carry ) ) );
+        carry = cdf[ i + 3 ];
+    }
+    __m128 const threshold = _mm_set1_ps ( uniform_ ( ) * carry );
+    int below              = 0;
+    for ( int i = 0; i < n_; i += 4 )
+        below += std::popcount (
+            static_cast<unsigned> ( _mm_movemask_ps ( _mm_cmple_ps ( _mm_load_ps ( cdf + i ), threshold ) ) ) );
+#endif
+    return std::min ( below, n_ - 1 );
+}
+
+// Boltzmann exploration by the Gumbel-max trick, argmax_i ( q_i / temperature_ + g_i ), g_i standard Gumbel noise (NaN
+// values stay NaN, select_greedy ( ) skips them).
+[[nodiscard]] inline int select_gumbel_max ( float const * q_, int n_, float temperature_, simd_sfc32 & noise_ ) noexcept {
+    alignas ( 32 ) float perturbed[ 128 ];
+    assert ( n_ <= 128 );
+#if defined( __AVX2__ )
+    __m256 const inverse = _mm256_set1_ps ( 1.0f / temperature_ );
+    for ( int i = 0; i < n_; i += 8 )
+        _mm256_store_ps ( perturbed + i, _mm256_fmadd_ps ( _mm256_loadu_ps ( q_ + i ), inverse, noise_.gumbel ( ) ) );
+#else
+    __m128 const inverse = _mm_set1_ps ( 1.0f / temperature_ );
+    for ( int i = 0; i < n_; i += 4 )
+        _mm_store_ps ( perturbed + i, _mm_add_ps ( _mm_mul_ps ( _mm_loadu_ps ( q_ + i ), inverse ), noise_.gumbel ( ) ) );
+#endif
+    return select_greedy ( perturbed, n_ );
+}
+
+TD_LEARNING_END_TARGET
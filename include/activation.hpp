@@ -0,0 +1,356 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <immintrin.h>
+
+#include <cmath>
+
+#include <algorithm>
+#include <ios>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include "td_learning/detail/simd_exp.inl"
+#include "td_learning/detail/simd_reduce.inl"
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+// Activation policies (the HiddenActivation and OutputActivation parameters of cascade_network). A policy is a struct of
+// static members:
+//
+//   apply ( float ), apply ( __m128 )           the activation of a net input,
+//   derivative ( float ), derivative ( __m128 ) its derivative, as a function of the activation (not of the net input),
+//                                                both also of __m256 with AVX2 and of __m512 with AVX-512F,
+//   name, source ( )                             for tools, source ( ) is a C++ expression of the activation of x_ (used
+//                                                by export_header ( )), constant if that expression is constexpr.
+//
+// A layer policy (is_layer, softmax) activates all outputs together, apply ( float *, n ) and apply_ps ( float *, n ) (the
+// latter may read n rounded up to a multiple of 8 floats, it leaves the padding as is), the outputs are the identity of their
+// net inputs until then, its derivative is 1, i.e. errors are w.r.t. the net inputs (as with a cross-entropy loss).
+
+namespace activation {
+
+struct identity {
+    static constexpr bool is_layer = false, constant = true;
+    static constexpr std::string_view name = "identity";
+    [[nodiscard]] static std::string source ( ) { return "x_"; }
+
+    [[nodiscard]] static float apply ( float x_ ) noexcept { return x_; }
+    [[nodiscard]] static __m128 apply ( __m128 x_ ) noexcept { return x_; }
+    [[nodiscard]] static float derivative ( float ) noexcept { return 1.0f; }
+    [[nodiscard]] static __m128 derivative ( __m128 ) noexcept { return _mm_set1_ps ( 1.0f ); }
+#if defined( __AVX2__ )
+    [[nodiscard]] static __m256 apply ( __m256 x_ ) noexcept { return x_; }
+    [[nodiscard]] static __m256 derivative ( __m256 ) noexcept { return _mm256_set1_ps ( 1.0f ); }
+#endif
+#if defined( __AVX512F__ )
+    [[nodiscard]] static __m512 apply ( __m512 x_ ) noexcept { return x_; }
+    [[nodiscard]] static __m512 derivative ( __m512 ) noexcept { return _mm512_set1_ps ( 1.0f ); }
+#endif
+};
+
+struct rectifier {
+    static constexpr bool is_layer = false, constant = true;
+    static constexpr std::string_view name = "relu";
+    [[nodiscard]] static std::string source ( ) { return "x_ > 0.0f ? x_ : 0.0f"; }
+
+    [[nodiscard]] static float apply ( float x_ ) noexcept { return x_ > 0.0f ? x_ : 0.0f; } // branchless after optimization
+    [[nodiscard]] static __m128 apply ( __m128 x_ ) noexcept { return _mm_max_ps ( x_, _mm_setzero_ps ( ) ); }
+    [[nodiscard]] static float derivative ( float y_ ) noexcept { return y_ > 0.0f ? 1.0f : 0.0f; }
+    [[nodiscard]] static __m128 derivative ( __m128 y_ ) noexcept {
+        return _mm_and_ps ( _mm_cmpgt_ps ( y_, _mm_setzero_ps ( ) ), _mm_set1_ps ( 1.0f ) );
+    }
+#if defined( __AVX2__ )
+    [[nodiscard]] static __m256 apply ( __m256 x_ ) noexcept { return _mm256_max_ps ( x_, _mm256_setzero_ps ( ) ); }
+    [[nodiscard]] static __m256 derivative ( __m256 y_ ) noexcept {
+        return _mm256_and_ps ( _mm256_cmp_ps ( y_, _mm256_setzero_ps ( ), _CMP_GT_OQ ), _mm256_set1_ps ( 1.0f ) );
+    }
+#endif
+#if defined( __AVX512F__ )
+    [[nodiscard]] static __m512 apply ( __m512 x_ ) noexcept { return _mm512_max_ps ( x_, _mm512_setzero_ps ( ) ); }
+    [[nodiscard]] static __m512 derivative ( __m512 y_ ) noexcept {
+        return _mm512_maskz_mov_ps ( _mm512_cmp_ps_mask ( y_, _mm512_setzero_ps ( ), _CMP_GT_OQ ), _mm512_set1_ps ( 1.0f ) );
+    }
+#endif
+};
+
+// the source ( ) of a parametric_rectifier of alpha_ (also for tools taking alpha_ at run-time)
+[[nodiscard]] inline std::string parametric_rectifier_source ( float alpha_ ) {
+    std::ostringstream s;
+    s << "x_ > 0.0f ? x_ : x_ * " << std::hexfloat << alpha_ << 'f';
+    return s.str ( );
+}
+
+template<float Alpha>
+struct parametric_rectifier {
+    static constexpr bool is_layer = false, constant = true;
+    static constexpr std::string_view name = "parametric_relu";
+    [[nodiscard]] static std::string source ( ) { return parametric_rectifier_source ( Alpha ); }
+
+    [[nodiscard]] static float apply ( float x_ ) noexcept { return x_ > 0.0f ? x_ : x_ * Alpha; }
+    [[nodiscard]] static __m128 apply ( __m128 x_ ) noexcept {
+        return _mm_blendv_ps ( _mm_mul_ps ( x_, _mm_set1_ps ( Alpha ) ), x_, _mm_cmpgt_ps ( x_, _mm_setzero_ps ( ) ) );
+    }
+    [[nodiscard]] static float derivative ( float y_ ) noexcept { return y_ > 0.0f ? 1.0f : Alpha; }
+    [[nodiscard]] static __m128 derivative ( __m128 y_ ) noexcept {
+        return _mm_blendv_ps ( _mm_set1_ps ( Alpha ), _mm_set1_ps ( 1.0f ), _mm_cmpgt_ps ( y_, _mm_setzero_ps ( ) ) );
+    }
+#if defined( __AVX2__ )
+    [[nodiscard]] static __m256 apply ( __m256 x_ ) noexcept {
+        return _mm256_blendv_ps ( _mm256_mul_ps ( x_, _mm256_set1_ps ( Alpha ) ), x_,
+                                  _mm256_cmp_ps ( x_, _mm256_setzero_ps ( ), _CMP_GT_OQ ) );
+    }
+    [[nodiscard]] static __m256 derivative ( __m256 y_ ) noexcept {
+        return _mm256_blendv_ps ( _mm256_set1_ps ( Alpha ), _mm256_set1_ps ( 1.0f ),
+                                  _mm256_cmp_ps ( y_, _mm256_setzero_ps ( ), _CMP_GT_OQ ) );
+    }
+#endif
+#if defined( __AVX512F__ )
+    [[nodiscard]] static __m512 apply ( __m512 x_ ) noexcept {
+        __mmask16 const negative = _mm512_cmp_ps_mask ( x_, _mm512_setzero_ps ( ), _CMP_LE_OQ );
+        return _mm512_mask_mul_ps ( x_, negative, x_, _mm512_set1_ps ( Alpha ) );
+    }
+    [[nodiscard]] static __m512 derivative ( __m512 y_ ) noexcept {
+        return _mm512_mask_blend_ps ( _mm512_cmp_ps_mask ( y_, _mm512_setzero_ps ( ), _CMP_GT_OQ ), _mm512_set1_ps ( Alpha ),
+                                      _mm512_set1_ps ( 1.0f ) );
+    }
+#endif
+};
+
+struct leaky_rectifier : parametric_rectifier<0.01f> {
+    static constexpr std::string_view name = "leaky_relu";
+};
+
+// Elliott's sigmoid, x / ( 1 + | x | ), in ( -1, 1 )
+struct elliott {
+    static constexpr bool is_layer = false, constant = true;
+    static constexpr std::string_view name = "elliott";
+    [[nodiscard]] static std::string source ( ) { return "x_ / ( 1.0f + ( x_ < 0.0f ? -x_ : x_ ) )"; }
+
+    [[nodiscard]] static float apply ( float x_ ) noexcept { return x_ / ( 1.0f + std::abs ( x_ ) ); }
+    [[nodiscard]] static __m128 apply ( __m128 x_ ) noexcept {
+        return _mm_div_ps ( x_, _mm_add_ps ( _mm_set1_ps ( 1.0f ), abs ( x_ ) ) );
+    }
+    [[nodiscard]] static float derivative ( float y_ ) noexcept { // 1 / ( 1 + | x | )^2
+        float const d = 1.0f - std::abs ( y_ );
+        return d * d;
+    }
+    [[nodiscard]] static __m128 derivative ( __m128 y_ ) noexcept {
+        __m128 const d = _mm_sub_ps ( _mm_set1_ps ( 1.0f ), abs ( y_ ) );
+        return _mm_mul_ps ( d, d );
+    }
+#if defined( __AVX2__ )
+    [[nodiscard]] static __m256 apply ( __m256 x_ ) noexcept {
+        return _mm256_div_ps ( x_, _mm256_add_ps ( _mm256_set1_ps ( 1.0f ), abs ( x_ ) ) );
+    }
+    [[nodiscard]] static __m256 derivative ( __m256 y_ ) noexcept {
+        __m256 const d = _mm256_sub_ps ( _mm256_set1_ps ( 1.0f ), abs ( y_ ) );
+        return _mm256_mul_ps ( d, d );
+    }
+#endif
+#if defined( __AVX512F__ )
+    [[nodiscard]] static __m512 apply ( __m512 x_ ) noexcept {
+        return _mm512_div_ps ( x_, _mm512_add_ps ( _mm512_set1_ps ( 1.0f ), _mm512_abs_ps ( x_ ) ) );
+    }
+    [[nodiscard]] static __m512 derivative ( __m512 y_ ) noexcept {
+        __m512 const d = _mm512_sub_ps ( _mm512_set1_ps ( 1.0f ), _mm512_abs_ps ( y_ ) );
+        return _mm512_mul_ps ( d, d );
+    }
+#endif
+
+    private:
+    [[nodiscard]] static __m128 abs ( __m128 x_ ) noexcept { return _mm_andnot_ps ( _mm_set1_ps ( -0.0f ), x_ ); }
+#if defined( __AVX2__ )
+    [[nodiscard]] static __m256 abs ( __m256 x_ ) noexcept { return _mm256_andnot_ps ( _mm256_set1_ps ( -0.0f ), x_ ); }
+#endif
+};
+
+// 1 / ( 1 + e^-x ), in ( 0, 1 ), the SIMD apply of the given accuracy (see simd_exp.inl)
+template<simd_accuracy Accuracy = simd_accuracy_default>
+struct basic_logistic {
+    static constexpr bool is_layer = false, constant = false;
+    static constexpr std::string_view name = "logistic";
+    [[nodiscard]] static std::string source ( ) { return "1.0f / ( 1.0f + std::exp ( -x_ ) )"; }
+
+    [[nodiscard]] static float apply ( float x_ ) noexcept { return 1.0f / ( 1.0f + std::exp ( -x_ ) ); }
+    [[nodiscard]] static __m128 apply ( __m128 x_ ) noexcept { return logistic_ps<Accuracy> ( x_ ); }
+    [[nodiscard]] static float derivative ( float y_ ) noexcept { return y_ * ( 1.0f - y_ ); }
+    [[nodiscard]] static __m128 derivative ( __m128 y_ ) noexcept {
+        return _mm_mul_ps ( y_, _mm_sub_ps ( _mm_set1_ps ( 1.0f ), y_ ) );
+    }
+#if defined( __AVX2__ )
+    [[nodiscard]] static __m256 apply ( __m256 x_ ) noexcept { return logistic_ps<Accuracy> ( x_ ); }
+    [[nodiscard]] static __m256 derivative ( __m256 y_ ) noexcept {
+        return _mm256_mul_ps ( y_, _mm256_sub_ps ( _mm256_set1_ps ( 1.0f ), y_ ) );
+    }
+#endif
+#if defined( __AVX512F__ )
+    [[nodiscard]] static __m512 apply ( __m512 x_ ) noexcept { return logistic_ps<Accuracy> ( x_ ); }
+    [[nodiscard]] static __m512 derivative ( __m512 y_ ) noexcept {
+        return _mm512_mul_ps ( y_, _mm512_sub_ps ( _mm512_set1_ps ( 1.0f ), y_ ) );
+    }
+#endif
+};
+
+using logistic = basic_logistic<>;
+
+// in ( -1, 1 )
+template<simd_accuracy Accuracy = simd_accuracy_default>
+struct basic_tanh {
+    static constexpr bool is_layer = false, constant = false;
+    static constexpr std::string_view name = "tanh";
+    [[nodiscard]] static std::string source ( ) { return "std::tanh ( x_ )"; }
+
+    [[nodiscard]] static float apply ( float x_ ) noexcept { return std::tanh ( x_ ); }
+    [[nodiscard]] static __m128 apply ( __m128 x_ ) noexcept { return tanh_ps<Accuracy> ( x_ ); }
+    [[nodiscard]] static float derivative ( float y_ ) noexcept { return 1.0f - y_ * y_; }
+    [[nodiscard]] static __m128 derivative ( __m128 y_ ) noexcept {
+        return detail::simd_ops<__m128>::fnmadd ( y_, y_, _mm_set1_ps ( 1.0f ) );
+    }
+#if defined( __AVX2__ )
+    [[nodiscard]] static __m256 apply ( __m256 x_ ) noexcept { return tanh_ps<Accuracy> ( x_ ); }
+    [[nodiscard]] static __m256 derivative ( __m256 y_ ) noexcept { return _mm256_fnmadd_ps ( y_, y_, _mm256_set1_ps ( 1.0f ) ); }
+#endif
+#if defined( __AVX512F__ )
+    [[nodiscard]] static __m512 apply ( __m512 x_ ) noexcept { return tanh_ps<Accuracy> ( x_ ); }
+    [[nodiscard]] static __m512 derivative ( __m512 y_ ) noexcept { return _mm512_fnmadd_ps ( y_, y_, _mm512_set1_ps ( 1.0f ) ); }
+#endif
+};
+
+using tanh = basic_tanh<>;
+
+// the normalized exponential, e^x_i / sum_j e^x_j, over the outputs (shifted by the max, for range)
+struct softmax {
+    static constexpr bool is_layer = true, constant = false;
+    static constexpr std::string_view name = "softmax";
+    // statements on the array y_ of the outputs
+    [[nodiscard]] static std::string source ( ) {
+        return "float max = y_[ 0 ], sum = 0.0f;\n"
+               "    for ( float const v : y_ )\n"
+               "        max = v > max ? v : max;\n"
+               "    for ( float & v : y_ )\n"
+               "        sum += ( v = std::exp ( v - max ) );\n"
+               "    for ( float & v : y_ )\n"
+               "        v /= sum;\n";
+    }
+
+    [[nodiscard]] static float apply ( float x_ ) noexcept { return x_; } // per output, before apply ( float *, n )
+    [[nodiscard]] static __m128 apply ( __m128 x_ ) noexcept { return x_; }
+    [[nodiscard]] static float derivative ( float ) noexcept { return 1.0f; }
+    [[nodiscard]] static __m128 derivative ( __m128 ) noexcept { return _mm_set1_ps ( 1.0f ); }
+#if defined( __AVX2__ )
+    [[nodiscard]] static __m256 apply ( __m256 x_ ) noexcept { return x_; }
+    [[nodiscard]] static __m256 derivative ( __m256 ) noexcept { return _mm256_set1_ps ( 1.0f ); }
+#endif
+#if defined( __AVX512F__ )
+    [[nodiscard]] static __m512 apply ( __m512 x_ ) noexcept { return x_; }
+    [[nodiscard]] static __m512 derivative ( __m512 ) noexcept { return _mm512_set1_ps ( 1.0f ); }
+#endif
+
+    static void apply ( float * y_, int n_ ) noexcept {
+        float const max = *std::max_element ( y_, y_ + n_ );
+        float sum       = 0.0f;
+        for ( int i = 0; i < n_; ++i )
+            sum += ( y_[ i ] = std::exp ( y_[ i ] - max ) );
+        for ( int i = 0; i < n_; ++i )
+            y_[ i ] /= sum;
+    }
+
+#if defined( __AVX512F__ )
+    static void apply_ps ( float * y_, int n_ ) noexcept { // reads and writes n_ floats only
+        __m512 m = _mm512_set1_ps ( -std::numeric_limits<float>::infinity ( ) );
+        for ( int i = 0; i < n_; i += 16 )
+            m = _mm512_max_ps ( m, _mm512_mask_loadu_ps ( m, tail_mask<__m512> ( n_ - i ), y_ + i ) );
+        __m512 const max = _mm512_set1_ps ( _mm512_reduce_max_ps ( m ) );
+        __m512 sum       = _mm512_setzero_ps ( );
+        for ( int i = 0; i < n_; i += 16 ) {
+            __mmask16 const keep = tail_mask<__m512> ( n_ - i );
+            __m512 const e       = exp_ps ( _mm512_sub_ps ( _mm512_maskz_loadu_ps ( keep, y_ + i ), max ), keep );
+            _mm512_mask_storeu_ps ( y_ + i, keep, e );
+            sum = _mm512_add_ps ( sum, e );
+        }
+        __m512 const inverse = _mm512_set1_ps ( 1.0f / _mm512_reduce_add_ps ( sum ) );
+        for ( int i = 0; i < n_; i += 16 ) {
+            __mmask16 const keep = tail_mask<__m512> ( n_ - i );
+            _mm512_mask_storeu_ps ( y_ + i, keep, _mm512_mul_ps ( _mm512_maskz_loadu_ps ( keep, y_ + i ), inverse ) );
+        }
+    }
+#elif defined( __AVX2__ )
+    static void apply_ps ( float * y_, int n_ ) noexcept {
+        __m256i const lanes = _mm256_setr_epi32 ( 0, 1, 2, 3, 4, 5, 6, 7 );
+        auto const keep     = [ & ] ( int i_ ) noexcept { return _mm256_cmpgt_epi32 ( _mm256_set1_epi32 ( n_ - i_ ), lanes ); };
+        __m256 m = _mm256_set1_ps ( -std::numeric_limits<float>::infinity ( ) );
+        for ( int i = 0; i < n_; i += 8 )
+            m = _mm256_max_ps ( m, _mm256_blendv_ps ( m, _mm256_loadu_ps ( y_ + i ), _mm256_castsi256_ps ( keep ( i ) ) ) );
+        __m256 const max = _mm256_set1_ps ( _mm256_hmax_ps ( m ) );
+        __m256 sum       = _mm256_setzero_ps ( );
+        for ( int i = 0; i < n_; i += 8 ) {
+            __m256 const e = exp_ps ( _mm256_sub_ps ( _mm256_loadu_ps ( y_ + i ), max ), _mm256_castsi256_ps ( keep ( i ) ) );
+            _mm256_maskstore_ps ( y_ + i, keep ( i ), e );
+            sum = _mm256_add_ps ( sum, e );
+        }
+        __m128 s = _mm_add_ps ( _mm256_castps256_ps128 ( sum ), _mm256_extractf128_ps ( sum, 1 ) );
+        s        = _mm_add_ps ( s, _mm_movehl_ps ( s, s ) );
+        s        = _mm_add_ss ( s, _mm_movehdup_ps ( s ) );
+        __m256 const inverse = _mm256_set1_ps ( 1.0f / _mm_cvtss_f32 ( s ) );
+        for ( int i = 0; i < n_; i += 8 )
+            _mm256_maskstore_ps ( y_ + i, keep ( i ), _mm256_mul_ps ( _mm256_loadu_ps ( y_ + i ), inverse ) );
+    }
+#else
+    static void apply_ps ( float * y_, int n_ ) noexcept { // reads n_ rounded up to a multiple of 4 floats, writes n_
+        __m128i const lanes = _mm_setr_epi32 ( 0, 1, 2, 3 );
+        auto const keep     = [ & ] ( int i_ ) noexcept {
+            return _mm_castsi128_ps ( _mm_cmpgt_epi32 ( _mm_set1_epi32 ( n_ - i_ ), lanes ) );
+        };
+        auto const store = [ & ] ( int i_, __m128 x_ ) noexcept { // the lanes before n_
+            if ( i_ + 4 <= n_ )
+                _mm_storeu_ps ( y_ + i_, x_ );
+            else
+                _mm_storeu_ps ( y_ + i_, _mm_blendv_ps ( _mm_loadu_ps ( y_ + i_ ), x_, keep ( i_ ) ) );
+        };
+        __m128 m = _mm_set1_ps ( -std::numeric_limits<float>::infinity ( ) );
+        for ( int i = 0; i < n_; i += 4 )
+            m = _mm_max_ps ( m, _mm_blendv_ps ( m, _mm_loadu_ps ( y_ + i ), keep ( i ) ) );
+        __m128 const max = _mm_set1_ps ( _mm_hmax_ps ( m ) );
+        __m128 sum       = _mm_setzero_ps ( );
+        for ( int i = 0; i < n_; i += 4 ) {
+            __m128 const e = exp_ps ( _mm_sub_ps ( _mm_loadu_ps ( y_ + i ), max ), keep ( i ) );
+            store ( i, e );
+            sum = _mm_add_ps ( sum, e );
+        }
+        sum                  = _mm_add_ps ( sum, _mm_movehl_ps ( sum, sum ) );
+        __m128 const inverse = _mm_set1_ps ( 1.0f / _mm_cvtss_f32 ( _mm_add_ss ( sum, _mm_movehdup_ps ( sum ) ) ) );
+        for ( int i = 0; i < n_; i += 4 )
+            store ( i, _mm_mul_ps ( _mm_loadu_ps ( y_ + i ), inverse ) );
+    }
+#endif
+};
+
+} // namespace activation
+
+TD_LEARNING_END_TARGET
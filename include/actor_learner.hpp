@@ -0,0 +1,188 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#include "action_selection.hpp"
+#include "replay_buffer.hpp"
+#include "td_learning/rng.hpp"
+#include "td_learning/concurrent_ring_span.hpp"
+#include "td_learning/triple_buffer.hpp"
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+// actor_learner
+//
+//   A local IMPALA-style pipeline. Every actor thread owns an Environment, a scratch instance of the Network and a weight
+//   snapshot (triple_buffer), steps its environment and streams transitions to the learners through its own lock-free queue
+//   (an spsc_ring_span over storage owned by the actor, queue_capacity is rounded up to a power of 2).
+//   Learner threads batch the transitions of their share of the actors and call Update ( Network &, batch ) on the master
+//   network, after which the new weights are published to all actors. Updates (not the batching) are serialized. Every
+//   learner serves at least one actor, learners are clamped to [ 1, actors ].
+//
+//   Environment requirements:
+//
+//       template<typename Generator> void reset ( Generator & );
+//       void observe ( span_ps ) const;                           // writes Network::NumRaw floats
+//       template<typename Generator> float step ( int, Generator & ); // applies the action, returns the reward
+//       bool terminal ( ) const;
+//
+template<typename Network, typename Environment, typename Update>
+class actor_learner {
+
+    public:
+    using transition_type = transition<Network::NumRaw>;
+    using batch_type      = std::span<transition_type const>;
+
+    struct parameters {
+        int actors, learners = 1, batch_size = 32, queue_capacity = 1'024;
+        float epsilon = 0.1f; // exploration
+    };
+
+    actor_learner ( Network & network_, Environment const & environment_, Update update_, parameters const & parameters_ ) :
+        m_network ( network_ ), m_update ( std::move ( update_ ) ), m_parameters ( parameters_ ) {
+        m_parameters.learners = std::clamp ( m_parameters.learners, 1, std::max ( 1, m_parameters.actors ) );
+        for ( int a = 0; a < m_parameters.actors; ++a )
+            m_actors.emplace_back ( std::make_unique<actor> ( m_network, environment_, m_parameters.queue_capacity ) );
+    }
+
+    ~actor_learner ( ) noexcept { stop ( ); }
+
+    void start ( ) {
+        for ( int a = 0; a < m_parameters.actors; ++a )
+            m_threads.emplace_back ( [ this, a ] ( std::stop_token stop_ ) noexcept { act ( stop_, *m_actors[ a ], a ); } );
+        for ( int l = 0; l < m_parameters.learners; ++l )
+            m_threads.emplace_back ( [ this, l ] ( std::stop_token stop_ ) { learn ( stop_, l ); } );
+    }
+
+    void stop ( ) noexcept {
+        for ( auto & t : m_threads )
+            t.request_stop ( );
+        m_threads.clear ( ); // joins
+    }
+
+    [[nodiscard]] std::int64_t steps ( ) const noexcept { return m_steps.load ( std::memory_order_relaxed ); }
+    [[nodiscard]] std::int64_t updates ( ) const noexcept { return m_updates.load ( std::memory_order_relaxed ); }
+
+    private:
+    struct actor {
+        actor ( Network const & network_, Environment const & environment_, int queue_capacity_ ) :
+            network ( network_ ), environment ( environment_ ), weights ( network_.weights ),
+            storage ( std::bit_ceil ( static_cast<unsigned> ( queue_capacity_ ) ) ),
+            queue ( std::begin ( storage ), std::end ( storage ) ) {}
+
+        Network network;
+        Environment environment;
+        triple_buffer<typename Network::wgt_type> weights;
+        std::vector<transition_type> storage;
+        spsc_ring_span<transition_type> queue;
+    };
+
+    // the randomness of episode e of actor a_ is Rng::stream ( a_, e ), whatever thread runs it
+    void act ( std::stop_token stop_, actor & actor_, int a_ ) noexcept {
+        std::uint32_t episode = 0;
+        philox_stream rng     = Rng::stream ( a_, episode );
+        uniform_batch<philox_stream> uniform ( rng );
+        auto & raw = actor_.network.space.raw ( );
+        actor_.environment.reset ( rng );
+        actor_.environment.observe ( raw );
+        transition_type t;
+        while ( not stop_.stop_requested ( ) ) {
+            actor_.network.feed_forward ( actor_.weights.acquire ( ).data ( ) );
+            t.state  = raw;
+            t.action = select_epsilon_greedy ( actor_.network.space.out ( ).data ( ), Network::NumOut, m_parameters.epsilon,
+                                               uniform );
+            t.reward = actor_.environment.step ( t.action, rng );
+            t.done   = actor_.environment.terminal ( );
+            if ( t.done ) {
+                rng = Rng::stream ( a_, ++episode );
+                uniform.reset ( );
+                actor_.environment.reset ( rng );
+            }
+            actor_.environment.observe ( t.next_state );
+            while ( not actor_.queue.push_back ( t ) ) { // back-pressure, the learners are behind
+                if ( stop_.stop_requested ( ) )
+                    return;
+                std::this_thread::yield ( );
+            }
+            raw = t.next_state;
+            m_steps.fetch_add ( 1, std::memory_order_relaxed );
+        }
+    }
+
+    void learn ( std::stop_token stop_, int learner_ ) {
+        std::vector<transition_type> batch ( m_parameters.batch_size );
+        std::size_t size = 0;
+        while ( not stop_.stop_requested ( ) ) {
+            bool idle = true;
+            for ( int a = learner_; a < m_parameters.actors; a += m_parameters.learners ) {
+                if ( std::size_t const n = m_actors[ a ]->queue.pop_front_n ( batch.data ( ) + size, batch.size ( ) - size ) ) {
+                    size += n;
+                    idle = false;
+                }
+                if ( size == batch.size ( ) ) {
+                    apply ( batch );
+                    size = 0;
+                }
+            }
+            if ( idle )
+                std::this_thread::yield ( );
+        }
+    }
+
+    void apply ( std::vector<transition_type> const & batch_ ) {
+        std::scoped_lock lock ( m_update_mutex );
+        m_update ( m_network, batch_type{ batch_ } );
+        for ( auto & a : m_actors )
+            a->weights.publish ( m_network.weights );
+        m_updates.fetch_add ( 1, std::memory_order_relaxed );
+    }
+
+    Network & m_network; // master
+    Update m_update;
+    parameters m_parameters;
+
+    std::vector<std::unique_ptr<actor>> m_actors;
+    std::vector<std::jthread> m_threads;
+    std::mutex m_update_mutex;
+
+    alignas ( 64 ) std::atomic<std::int64_t> m_steps = 0;
+    alignas ( 64 ) std::atomic<std::int64_t> m_updates = 0;
+};
+
+TD_LEARNING_END_TARGET
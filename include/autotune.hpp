@@ -0,0 +1,174 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "cascade_network.hpp"
+#include "td_learning/cpu_features.hpp"
+#include "td_learning/simd_sfc.hpp"
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+// autotune_forward
+//
+//   Times the forward_kernel's of a batched forward pass (a cblas_sdot per row and neuron, the inlined intrinsic dot per
+//   row and neuron, a cblas_sgemv per neuron over all rows) on a batch of batch_size_ random rows and returns the fastest.
+//   Which one wins depends on the shape of the network, the batch size, the cpu and the BLAS library, so the choice is
+//   cached in a text file, one line per cpu model (the cpuid brand string), target (the intrinsic dot is compiled for it,
+//   see simd_target.hpp) and shape:
+//
+//       <brand> <target>|<NumInput> <NumOnes> <NumOutput> <NumNeurons> <hidden> <output> <batch size>|<kernel>
+//
+//   The cache is read tolerantly (unknown lines are skipped) and rewritten atomically (to a temporary, then renamed),
+//   failing to read or write it only costs a re-measurement. An empty cache path disables the cache.
+//
+//       q_learner<network> learner ( net, { .batch_size = 64, .autotune = true } ); // or:
+//       net.feed_forward ( batch, net.weights.data ( ), autotune_forward ( net, batch.size ( ) ) );
+//
+struct autotune_parameters {
+    std::filesystem::path cache = default_cache ( );
+    int trials                  = 5;     // the best of
+    double trial_seconds        = 0.002; // minimum duration of a trial, sets the number of forward passes per trial
+
+    // $TD_LEARNING_AUTOTUNE_CACHE, or td_learning_autotune.txt in the temporary directory
+    [[nodiscard]] static std::filesystem::path default_cache ( ) {
+        if ( char const * const path = std::getenv ( "TD_LEARNING_AUTOTUNE_CACHE" ) )
+            return path;
+        std::error_code error;
+        std::filesystem::path const directory = std::filesystem::temp_directory_path ( error );
+        return error ? std::filesystem::path ( ) : directory / "td_learning_autotune.txt";
+    }
+};
+
+namespace detail {
+
+[[nodiscard]] inline bool find_forward_kernel ( std::string_view name_, forward_kernel & kernel_ ) noexcept {
+    for ( int k = 0; k < static_cast<int> ( std::size ( forward_kernel_names ) ); ++k )
+        if ( forward_kernel_names[ k ] == name_ ) {
+            kernel_ = static_cast<forward_kernel> ( k );
+            return true;
+        }
+    return false;
+}
+
+[[nodiscard]] inline std::vector<std::string> read_autotune_cache ( std::filesystem::path const & path_ ) {
+    std::vector<std::string> lines;
+    std::ifstream stream ( path_ );
+    for ( std::string line; std::getline ( stream, line ); )
+        if ( std::count ( std::begin ( line ), std::end ( line ), '|' ) == 2 )
+            lines.push_back ( std::move ( line ) );
+    return lines;
+}
+
+// replaces the line of key_ (if any), best effort, through a temporary of a random name (processes autotune concurrently)
+inline void write_autotune_cache ( std::filesystem::path const & path_, std::string const & key_, forward_kernel kernel_ ) {
+    std::vector<std::string> lines = read_autotune_cache ( path_ );
+    std::erase_if ( lines, [ & ] ( std::string const & l_ ) { return l_.starts_with ( key_ ); } );
+    lines.push_back ( key_ + std::string ( forward_kernel_names[ static_cast<int> ( kernel_ ) ] ) );
+    std::random_device random;
+    std::filesystem::path tmp = path_;
+    tmp += "." + std::to_string ( ( std::uint64_t{ random ( ) } << 32 ) | random ( ) ) + ".tmp";
+    std::error_code error;
+    {
+        std::ofstream stream ( tmp, std::ios::trunc );
+        for ( auto const & l : lines )
+            stream << l << '\n';
+        if ( not stream.flush ( ) ) {
+            stream.close ( );
+            std::filesystem::remove ( tmp, error );
+            return;
+        }
+    }
+    std::filesystem::rename ( tmp, path_, error );
+    if ( error )
+        std::filesystem::remove ( tmp, error );
+}
+
+// seconds per forward pass of the batch, the best of trials_
+template<typename Network>
+[[nodiscard]] double time_forward ( Network const & network_, typename Network::batch_type & batch_, forward_kernel kernel_,
+                                    autotune_parameters const & parameters_ ) noexcept {
+    using clock = std::chrono::steady_clock;
+    auto run    = [ & ] ( std::int64_t n_ ) noexcept {
+        auto const t0 = clock::now ( );
+        for ( std::int64_t i = 0; i < n_; ++i )
+            network_.feed_forward ( batch_, network_.weights.data ( ), kernel_ );
+        return std::chrono::duration<double> ( clock::now ( ) - t0 ).count ( );
+    };
+    std::int64_t n = 1;
+    run ( n ); // warm up
+    for ( double t = run ( n ); t < parameters_.trial_seconds; t = run ( n ) )
+        n *= 2;
+    double best = std::numeric_limits<double>::max ( );
+    for ( int t = 0; t < parameters_.trials; ++t )
+        best = std::min ( best, run ( n ) / n );
+    return best;
+}
+
+} // namespace detail
+
+template<typename Network>
+[[nodiscard]] forward_kernel autotune_forward ( Network const & network_, int batch_size_,
+                                                autotune_parameters const & parameters_ = { } ) {
+    std::ostringstream key;
+    key << cpu_features::detect ( ).brand << ' ' << TD_LEARNING_TARGET_NAME << '|';
+    for ( auto const s : Network::shape )
+        key << s << ' ';
+    key << Network::hidden_activation::name << ' ' << Network::output_activation::name << ' ' << batch_size_ << '|';
+    if ( not parameters_.cache.empty ( ) )
+        for ( auto const & l : detail::read_autotune_cache ( parameters_.cache ) )
+            if ( forward_kernel k; l.starts_with ( key.str ( ) ) and
+                                   detail::find_forward_kernel ( std::string_view ( l ).substr ( key.str ( ).size ( ) ), k ) )
+                return k;
+    typename Network::batch_type batch ( batch_size_ );
+    simd_sfc32 rng ( 0x9e37'79b9'7f4a'7c15ull );
+    for ( int r = 0; r < batch_size_; ++r )
+        rng.fill_uniform ( batch.raw ( r ).data ( ), Network::NumRaw, -1.0f, 1.0f );
+    forward_kernel best = forward_kernel::gemv;
+    double best_time    = std::numeric_limits<double>::max ( );
+    for ( auto const k : { forward_kernel::sdot, forward_kernel::intrinsic, forward_kernel::gemv } )
+        if ( double const t = detail::time_forward ( network_, batch, k, parameters_ ); t < best_time )
+            best = k, best_time = t;
+    if ( not parameters_.cache.empty ( ) )
+        detail::write_autotune_cache ( parameters_.cache, key.str ( ), best );
+    return best;
+}
+
+TD_LEARNING_END_TARGET
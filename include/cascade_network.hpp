@@ -30,7 +30,11 @@
 #include <emmintrin.h>
 #include <smmintrin.h>
 
+#include "activation.hpp"
+#include "td_learning/detail/simd_blas.inl"
 #include "td_learning/detail/simd_exp.inl"
+#include "td_learning/detail/simd_reduce.inl"
+#include "td_learning/simd_sfc.hpp"
 
 #include <cmath>
 #include <cstddef>
@@ -46,11 +50,18 @@
 #include <random>
 #include <sax/iostream.hpp>
 #include <span>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
 
 #include <cereal/archives/binary.hpp>
 #include <cereal/cereal.hpp>
 #include <cereal/types/array.hpp>
 
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
 using span_ps       = std::span<float>;
 using const_span_ps = std::span<float const>;
 
@@ -61,41 +72,64 @@ template<int NumInput, int NumOnes, int NumOutput, int NumNeurons>
 class scratch_space;
 
 template<int NumInput, int NumOnes, int NumOutput, int NumNeurons>
+class batch_space;
+
+template<int NumInput, int NumOnes, int NumOutput, int NumNeurons, typename HiddenActivation = activation::rectifier,
+         typename OutputActivation = activation::rectifier>
 struct cascade_network;
 
+// the alignment (in bytes) of the scratch spaces and the padding of their out arrays, a multiple of the simd width
+#if not defined( TD_LEARNING_SIMD_ALIGNMENT )
+#    if defined( __AVX512F__ )
+#        define TD_LEARNING_SIMD_ALIGNMENT 64
+#    else
+#        define TD_LEARNING_SIMD_ALIGNMENT 32
+#    endif
+#endif
+
+// the implementations of the batched forward pass (see autotune.hpp): per row and neuron a cblas_sdot or an inlined
+// intrinsic dot product, or per neuron one cblas_sgemv over all rows
+enum class forward_kernel { sdot, intrinsic, gemv };
+
+inline constexpr std::string_view forward_kernel_names[ ] = { "sdot", "intrinsic", "gemv" };
+
 namespace calc {
 
+inline constexpr int simd_alignment = TD_LEARNING_SIMD_ALIGNMENT, simd_floats = simd_alignment / sizeof ( float );
+
+static_assert ( simd_alignment == 32 or simd_alignment == 64, "TD_LEARNING_SIMD_ALIGNMENT should be 32 or 64" );
+
 inline constexpr int roundup_multiple ( int i_, int m_ ) noexcept { return ( ( i_ + m_ - 1 ) / m_ ) * m_; }
 
 namespace detail {
 
 template<int NumInput, int NumOnes, int NumOutput, int NumNeurons, int Padding>
-struct alignas ( 32 ) aligned_storage { // every array can be cache aligned - blas-strides != 1
+struct alignas ( simd_alignment ) aligned_storage { // every array can be cache aligned - blas-strides != 1
 
     template<int, int, int>
     friend class scratch_space;
-    template<int, int, int, int>
+    template<int, int, int, int, typename, typename>
     friend class cascade_network;
 
     std::array<float, Padding> _ = { };
     std::array<float, NumInput> raw;
     std::array<float, NumOnes> one;
     std::array<float, NumNeurons - NumOutput> hid;
-    std::array<float, roundup_multiple ( NumOutput, 32 / sizeof ( float ) )> out; // out is AVX ready
+    std::array<float, roundup_multiple ( NumOutput, simd_floats )> out; // out is SIMD ready
 };
 
 template<int NumInput, int NumOnes, int NumOutput, int NumNeurons>
-struct alignas ( 32 ) aligned_storage<NumInput, NumOnes, NumOutput, NumNeurons, 0> {
+struct alignas ( simd_alignment ) aligned_storage<NumInput, NumOnes, NumOutput, NumNeurons, 0> {
 
     template<int, int, int>
     friend class scratch_space;
-    template<int, int, int, int>
+    template<int, int, int, int, typename, typename>
     friend class cascade_network;
 
     std::array<float, NumInput> raw;
     std::array<float, NumOnes> one;
     std::array<float, NumNeurons - NumOutput> hid;
-    std::array<float, roundup_multiple ( NumOutput, 32 / sizeof ( float ) )> out; // out is AVX ready
+    std::array<float, roundup_multiple ( NumOutput, simd_floats )> out; // out is SIMD ready
 };
 
 } // namespace detail
@@ -106,6 +140,8 @@ class space {
     template<int, int, int, int>
     friend class scratch_space;
     template<int, int, int, int>
+    friend class batch_space;
+    template<int, int, int, int, typename, typename>
     friend class cascade_network;
 
     void zero ( ) noexcept {
@@ -114,7 +150,7 @@ class space {
     }
 
     detail::aligned_storage<NumInput, NumOnes, NumOutput, NumNeurons,
-                            roundup_multiple ( ( NumInput + NumOnes + NumNeurons ) - NumOutput, 32 / sizeof ( float ) ) -
+                            roundup_multiple ( ( NumInput + NumOnes + NumNeurons ) - NumOutput, simd_floats ) -
                                 ( ( NumInput + NumOnes + NumNeurons ) - NumOutput )>
         storage;
 };
@@ -143,7 +179,7 @@ reverse_container_wrapper<T> reverse_container_adaptor ( T && reverse_iterable_
 template<int NumInput, int NumOnes, int NumOutput, int NumNeurons>
 class scratch_space {
 
-    template<int, int, int, int>
+    template<int, int, int, int, typename, typename>
     friend class cascade_network;
 
     using space = space<NumInput, NumOnes, NumOutput, NumNeurons>;
@@ -204,15 +240,62 @@ class scratch_space {
     space scratch;
 };
 
+// batch_space
+//
+//   A scratch space per sample of a mini-batch, rows of the 'space' layout, so the same neuron of all rows forms a column with a
+//   constant stride (for cblas_sgemv) and every row has a SIMD ready out array. The padding lanes of out are -inf, so that
+//   horizontal (max-) reductions can run over the padded array.
+template<int NumInput, int NumOnes, int NumOutput, int NumNeurons>
+class batch_space {
+
+    template<int, int, int, int, typename, typename>
+    friend class cascade_network;
+
+    using space_type = space<NumInput, NumOnes, NumOutput, NumNeurons>;
+
+    public:
+    static constexpr int NumOutPadded = roundup_multiple ( NumOutput, simd_floats );
+
+    explicit batch_space ( int size_ ) : rows ( size_ ) {
+        for ( auto & r : rows ) {
+            r.zero ( );
+            std::fill ( std::begin ( r.storage.out ) + NumOutput, std::end ( r.storage.out ),
+                        -std::numeric_limits<float>::infinity ( ) );
+        }
+    }
+
+    [[nodiscard]] int size ( ) const noexcept { return static_cast<int> ( rows.size ( ) ); }
+    // floats from one row to the next
+    [[nodiscard]] static constexpr int stride ( ) noexcept { return sizeof ( space_type ) / sizeof ( float ); }
+
+    // includes bias
+    [[nodiscard]] float * data ( int r_ ) noexcept { return rows[ r_ ].storage.raw.data ( ); }
+    [[nodiscard]] float const * data ( int r_ ) const noexcept { return rows[ r_ ].storage.raw.data ( ); }
+
+    [[nodiscard]] span_ps raw ( int r_ ) noexcept { return { rows[ r_ ].storage.raw.data ( ), NumInput }; }
+    [[nodiscard]] const_span_ps raw ( int r_ ) const noexcept { return { rows[ r_ ].storage.raw.data ( ), NumInput }; }
+
+    [[nodiscard]] span_ps out ( int r_ ) noexcept { return { rows[ r_ ].storage.out.data ( ), NumOutput }; }
+    [[nodiscard]] const_span_ps out ( int r_ ) const noexcept { return { rows[ r_ ].storage.out.data ( ), NumOutput }; }
+
+    // simd_alignment aligned, NumOutPadded floats, padding lanes are -inf
+    [[nodiscard]] float * out_padded ( int r_ ) noexcept { return rows[ r_ ].storage.out.data ( ); }
+    [[nodiscard]] float const * out_padded ( int r_ ) const noexcept { return rows[ r_ ].storage.out.data ( ); }
+
+    private:
+    std::vector<space_type> rows; // over-aligned, std::allocator uses aligned new
+};
+
 } // namespace calc
 
 // cascade_network
 //
 //   In a 'cascade_network' all up-stream neurons are input to all down-stream neurons. The last neuron receives input from all
 //   neurons (incl. itself), all biases, and all raw-inputs. In this model, all neurons are a single neuron in its respective 'own'
-//   layer.
+//   layer. The activations of the hidden and of the output neurons are policies (see activation.hpp), a layer policy
+//   (softmax) is applied to all outputs at the end of a forward pass.
 //
-template<int NumInput, int NumOnes, int NumOutput, int NumNeurons>
+template<int NumInput, int NumOnes, int NumOutput, int NumNeurons, typename HiddenActivation, typename OutputActivation>
 struct cascade_network {
 
     static_assert ( NumNeurons >= NumOutput, "number of neurons needs to be equal or larger than the number of required outputs" );
@@ -225,11 +308,24 @@ struct cascade_network {
 
     static constexpr int NumWeights = ( NumNeurons * NumInp ) + ( NumNeurons - 1 ) * ( NumNeurons ) / 2;
 
+    static constexpr int NumRaw = NumInput; // excludes bias
+    static constexpr int NumOut = NumOutput;
+    static constexpr int NumHid = NumNeurons - NumOutput;
+
+    using hidden_activation = HiddenActivation;
+    using output_activation = OutputActivation;
+
+    static_assert ( not HiddenActivation::is_layer, "a layer activation can only activate the outputs" );
+
+    static constexpr std::array<std::int32_t, 4> shape = { NumInput, NumOnes, NumOutput, NumNeurons };
+
     static constexpr float alpha = 0.25f; // learning
 
     using wgt_type = std::array<float, NumWeights>;
     using out_type = std::array<float, NumOutput>;
 
+    using batch_type = calc::batch_space<NumInput, NumOnes, NumOutput, NumNeurons>;
+
     using pointer        = typename wgt_type::pointer;
     using const_pointer  = typename wgt_type::const_pointer;
     using iterator       = typename wgt_type::iterator;
@@ -237,8 +333,9 @@ struct cascade_network {
 
     template<typename Generator>
     cascade_network ( Generator & rng_ ) noexcept {
-        std::uniform_real_distribution<float> dis ( -1.0f + FLT_EPSILON, 1.0f - FLT_EPSILON ); // closed interval
-        std::generate ( std::begin ( weights ), std::end ( weights ), [ &rng_, &dis ] ( ) noexcept { return dis ( rng_ ); } );
+        simd_sfc32 ( static_cast<std::uint64_t> ( rng_ ( ) ) )
+            .fill_uniform ( weights.data ( ), weights.size ( ), -1.0f + FLT_EPSILON, 1.0f - FLT_EPSILON ); // closed interval
+        space.clear_scratch_space ( ); // sets the biases
     }
 
     void feed_forward_soft_max ( ) noexcept {
@@ -252,15 +349,159 @@ struct cascade_network {
             ( ( o /= sum ) += max );
     }
 
-    void feed_forward ( ) noexcept {
-        auto dat = space.data ( ), wgt = weights.data ( );
-        int i = NumInp;
+    void feed_forward ( ) noexcept { feed_forward ( weights.data ( ) ); }
+
+    // evaluates 'this' scratch space against an external weight array (of NumWeights), f.e. a published snapshot.
+    void feed_forward ( const_pointer weights_ ) noexcept {
+        auto dat = space.data ( );
+        auto wgt = weights_;
+        int i    = NumInp;
         for ( auto & n : space.neu ( ) ) {
-            n = rectifier_activation ( cblas_sdot ( i, dat, 1, wgt, 1 ) * alpha );
+            float const net = dot_ps ( dat, wgt, i ) * alpha;
+            n               = i < NumInp + NumHid ? HiddenActivation::apply ( net ) : OutputActivation::apply ( net );
             wgt += i++;
         }
+        if constexpr ( OutputActivation::is_layer )
+            OutputActivation::apply_ps ( space.out ( ).data ( ), NumOutput );
+    }
+
+    // reads the raw input from input_ (NumInput contiguous floats, f.e. a mirrored_ring_buffer window) instead of raw ( ).
+    void feed_forward ( float const * input_, const_pointer weights_ ) noexcept {
+        auto dat = space.data ( ) + NumInput;
+        auto wgt = weights_;
+        int i    = NumOnes;
+        for ( auto & n : space.neu ( ) ) {
+            float const net = ( dot_ps ( input_, wgt, NumInput ) + dot_ps ( dat, wgt + NumInput, i ) ) * alpha;
+            n               = i < NumOnes + NumHid ? HiddenActivation::apply ( net ) : OutputActivation::apply ( net );
+            wgt += NumInput + i++;
+        }
+        if constexpr ( OutputActivation::is_layer )
+            OutputActivation::apply_ps ( space.out ( ).data ( ), NumOutput );
+    }
+
+    // feeds one batch row (all_ is the row incl. bias, the activations are written in place) forward, each neuron one dot
+    // product with the kernel K (sdot or intrinsic), the output layer activation (if any) is left to the caller.
+    template<forward_kernel K>
+    void feed_forward_row ( float * all_, const_pointer weights_ ) const noexcept {
+        auto wgt = weights_;
+        for ( int i = NumInp; i < NumInp + NumNeurons; ++i ) {
+            float net;
+            if constexpr ( K == forward_kernel::intrinsic )
+                net = dot_unrolled_ps ( all_, wgt, i ) * alpha;
+            else
+                net = cblas_sdot ( i, all_, 1, wgt, 1 ) * alpha;
+            all_[ i ] = i < NumInp + NumHid ? HiddenActivation::apply ( net ) : OutputActivation::apply ( net );
+            wgt += i;
+        }
+    }
+
+    // feeds all rows of batch_ forward with the given kernel (the fastest depends on the shape, the batch size and the cpu)
+    void feed_forward ( batch_type & batch_, const_pointer weights_, forward_kernel kernel_ ) const noexcept {
+        switch ( kernel_ ) {
+            case forward_kernel::sdot:
+                for ( int r = 0; r < batch_.size ( ); ++r )
+                    feed_forward_row<forward_kernel::sdot> ( batch_.data ( r ), weights_ );
+                break;
+            case forward_kernel::intrinsic:
+                for ( int r = 0; r < batch_.size ( ); ++r )
+                    feed_forward_row<forward_kernel::intrinsic> ( batch_.data ( r ), weights_ );
+                break;
+            default: feed_forward ( batch_, weights_ );
+        }
+        if constexpr ( OutputActivation::is_layer )
+            if ( kernel_ != forward_kernel::gemv )
+                for ( int r = 0; r < batch_.size ( ); ++r )
+                    OutputActivation::apply_ps ( batch_.out_padded ( r ), NumOutput );
+    }
+
+    // feeds all rows of batch_ forward, one cblas_sgemv per neuron (over the column of that neuron in all rows).
+    void feed_forward ( batch_type & batch_, const_pointer weights_ ) const noexcept {
+        int const ld = batch_type::stride ( );
+        float * dat  = batch_.data ( 0 );
+        auto wgt     = weights_;
+        int i        = NumInp;
+        for ( int n = 0; n < NumNeurons; ++n ) {
+            float * col = dat + i;
+            cblas_sgemv ( CblasRowMajor, CblasNoTrans, batch_.size ( ), i, alpha, dat, ld, wgt, 1, 0.0f, col, ld );
+            if ( n < NumHid )
+                for ( int r = 0; r < batch_.size ( ); ++r, col += ld )
+                    *col = HiddenActivation::apply ( *col );
+            else
+                for ( int r = 0; r < batch_.size ( ); ++r, col += ld )
+                    *col = OutputActivation::apply ( *col );
+            wgt += i++;
+        }
+        if constexpr ( OutputActivation::is_layer )
+            for ( int r = 0; r < batch_.size ( ); ++r )
+                OutputActivation::apply_ps ( batch_.out_padded ( r ), NumOutput );
+    }
+
+    // accumulates the gradient of 0.5 * error_^2 w.r.t. the weights into gradient_, error_ being the error of output output_
+    // after a forward pass of the activations in all_ (a scratch space or batch row, incl. bias). The later outputs take the
+    // earlier ones before a layer activation (softmax) overwrites them, with one the outputs of the row are recomputed.
+    void accumulate_gradient ( float const * all_, int output_, float error_, const_pointer weights_,
+                               pointer gradient_ ) const noexcept {
+        if constexpr ( OutputActivation::is_layer ) {
+            alignas ( 64 ) std::array<float, NumInpHidOut> row;
+            std::copy ( all_, all_ + NumInpHid, row.data ( ) );
+            const_pointer wgt = weights_ + NumHid * NumInp + NumHid * ( NumHid - 1 ) / 2; // of the first output neuron
+            for ( int i = NumInpHid; i < NumInpHidOut; wgt += i++ )
+                row[ i ] = OutputActivation::apply ( dot_ps ( row.data ( ), wgt, i ) * alpha );
+            backward ( row.data ( ), output_, error_, weights_, gradient_ );
+        }
+        else {
+            backward ( all_, output_, error_, weights_, gradient_ );
+        }
     }
 
+    private:
+    void backward ( float const * all_, int output_, float error_, const_pointer weights_, pointer gradient_ ) const noexcept {
+        std::array<float, NumNeurons> derivative;
+#if defined( __AVX512F__ )
+        for ( int k = 0; k < NumNeurons; k += 16 ) { // hidden or output, per lane, the tail masked
+            __mmask16 const m = tail_mask<__m512> ( NumNeurons - k );
+            __m512 const y    = _mm512_maskz_loadu_ps ( m, all_ + NumInp + k );
+            _mm512_mask_storeu_ps ( derivative.data ( ) + k, m,
+                                    _mm512_mask_blend_ps ( tail_mask<__m512> ( NumHid - k ), OutputActivation::derivative ( y ),
+                                                           HiddenActivation::derivative ( y ) ) );
+        }
+#else
+        int k = 0;
+#    if defined( __AVX2__ )
+        for ( ; k + 8 <= NumNeurons; k += 8 ) { // hidden or output, per lane
+            __m256 const y      = _mm256_loadu_ps ( all_ + NumInp + k );
+            __m256 const hidden = _mm256_castsi256_ps (
+                _mm256_cmpgt_epi32 ( _mm256_set1_epi32 ( NumHid - k ), _mm256_setr_epi32 ( 0, 1, 2, 3, 4, 5, 6, 7 ) ) );
+            _mm256_storeu_ps ( derivative.data ( ) + k, _mm256_blendv_ps ( OutputActivation::derivative ( y ),
+                                                                            HiddenActivation::derivative ( y ), hidden ) );
+        }
+#    else
+        for ( ; k + 4 <= NumNeurons; k += 4 ) {
+            __m128 const y      = _mm_loadu_ps ( all_ + NumInp + k );
+            __m128 const hidden =
+                _mm_castsi128_ps ( _mm_cmpgt_epi32 ( _mm_set1_epi32 ( NumHid - k ), _mm_setr_epi32 ( 0, 1, 2, 3 ) ) );
+            _mm_storeu_ps ( derivative.data ( ) + k,
+                            _mm_blendv_ps ( OutputActivation::derivative ( y ), HiddenActivation::derivative ( y ), hidden ) );
+        }
+#    endif
+        for ( ; k < NumNeurons; ++k )
+            derivative[ k ] = k < NumHid ? HiddenActivation::derivative ( all_[ NumInp + k ] )
+                                         : OutputActivation::derivative ( all_[ NumInp + k ] );
+#endif
+        std::array<float, NumNeurons> delta = { };
+        delta[ NumNeurons - NumOutput + output_ ] = error_;
+        for ( int n = NumNeurons - 1; n >= 0; --n ) {
+            if ( delta[ n ] == 0.0f )
+                continue;
+            int const i = NumInp + n, w = n * NumInp + n * ( n - 1 ) / 2; // inputs and first weight of neuron n
+            float const d = delta[ n ] * derivative[ n ] * alpha;
+            axpy_ps ( gradient_ + w, d, all_, i );                   // weights of neuron n
+            axpy_ps ( delta.data ( ), d, weights_ + w + NumInp, n ); // up-stream neurons
+        }
+    }
+
+    public:
+
     // returns sum absolute error
     [[nodiscard]] float feed_backward ( out_type const & desired_activation_ ) const noexcept {
         float e   = 0.0f;
@@ -270,7 +511,7 @@ struct cascade_network {
             e += std::abs ( ( *p-- += derivative_normalized_exponential_function_activation ( o - *d-- ) ) );
 
         for ( auto & h : reverse_container_adaptor ( space.hid ( ) ) )
-            *p-- += derivative_rectifier_activation ( h );
+            *p-- += HiddenActivation::derivative ( h );
 
         return e;
     }
@@ -304,11 +545,15 @@ struct cascade_network {
     }
 
     [[nodiscard]] float parametric_rectifier_activation ( float net_alpha_, float rectifier_alpha_ ) const noexcept {
-        int n = 0;
-        std::memcpy ( &n, &net_alpha_, 1 );
-        n >>= 31;
-        net_alpha_ *= ( float ) n + std::forward<float> ( rectifier_alpha_ ) * ( float ) not( ( bool ) n );
-        return net_alpha_;
+        return net_alpha_ > 0.0f ? net_alpha_ : net_alpha_ * rectifier_alpha_; // branchless after optimization
+    }
+
+    [[nodiscard]] float derivative_parametric_rectifier_activation ( float activation_, float rectifier_alpha_ ) const noexcept {
+        return activation_ > 0.0f ? 1.0f : rectifier_alpha_;
+    }
+
+    [[nodiscard]] float derivative_rectifier_activation ( float activation_ ) const noexcept {
+        return derivative_parametric_rectifier_activation ( activation_, 0.00f );
     }
 
     [[nodiscard]] float rectifier_activation ( float net_alpha_ ) const noexcept {
@@ -356,6 +601,21 @@ struct cascade_network {
 
     static constexpr bool is_little_endian = hi_byte_index<short> ( );
 
+    // cereal, versioned, loading throws on a different version or shape
+    static constexpr std::uint32_t serialization_version = 1;
+
+    template<typename Archive>
+    void serialize ( Archive & archive_ ) {
+        std::uint32_t version                   = serialization_version;
+        std::array<std::int32_t, 4> stored_shape = shape;
+        archive_ ( version, stored_shape );
+        if ( version != serialization_version )
+            throw std::runtime_error ( "cascade_network: unknown serialization version" );
+        if ( stored_shape != shape )
+            throw std::runtime_error ( "cascade_network: the archive holds a network of a different shape" );
+        archive_ ( weights );
+    }
+
     template<typename Stream>
     [[maybe_unused]] friend Stream & operator<< ( Stream & out_, cascade_network const & w_ ) noexcept {
         for ( auto const v : w_.weights )
@@ -368,3 +628,5 @@ struct cascade_network {
 
     wgt_type weights;
 };
+
+TD_LEARNING_END_TARGET
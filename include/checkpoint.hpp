@@ -0,0 +1,380 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <immintrin.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined( _WIN32 )
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <unistd.h>
+#endif
+
+#include "td_learning/aligned_allocator.hpp"
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+// Incremental checkpoints of a fixed size state (the weights of a network, f.e. followed by the optimizer state), written
+// by a background thread. A checkpoint is either a base (the full state) or a delta against the last base: the indices of
+// the 64-byte blocks that changed since the base, and for each of those the xor of the block with the base block, words
+// with zero high bytes stored in fewer bytes (the low bytes of a float change first). That zero suppression (a 2-bit code
+// per word) is all the compression there is, it is not an entropy coder, compress the files with a general purpose coder
+// if storage matters more than the time of the writer. Restoring is the base, xor-ed with the latest delta. A new base is
+// written every rebase_period checkpoints (0: never by count), or when a delta would exceed rebase_fraction of the size of
+// the state.
+//
+// Files in the directory: 'base' and 'delta', replaced atomically (written to a temporary, flushed to the device, renamed,
+// then the directory flushed), a checkpoint written survives a power loss, not only a crash of the process.
+
+namespace detail {
+
+struct checkpoint_header {
+    char magic[ 8 ];
+    std::uint32_t version, blocks; // of the state; of the delta
+    std::uint64_t bytes, base, sequence, payload;
+};
+
+inline constexpr char checkpoint_base_magic[ 8 ]  = { 'T', 'D', 'C', 'K', 'B', 'A', 'S', 'E' };
+inline constexpr char checkpoint_delta_magic[ 8 ] = { 'T', 'D', 'C', 'K', 'D', 'L', 'T', 'A' };
+inline constexpr std::uint32_t checkpoint_version = 1;
+inline constexpr std::size_t checkpoint_block     = 64; // bytes
+
+// number of bytes of a word stored, by 2-bit code: zero, the low byte, the low two bytes, the whole word
+inline constexpr int checkpoint_word_bytes[ 4 ] = { 0, 1, 2, 4 };
+
+[[nodiscard]] inline std::size_t checkpoint_padded ( std::size_t bytes_ ) noexcept {
+    return ( bytes_ + checkpoint_block - 1 ) / checkpoint_block * checkpoint_block;
+}
+
+// appends a block of 16 words to out_: 4 bytes of codes, then the bytes of the words
+inline void compress_block ( std::uint32_t const * x_, std::vector<std::byte> & out_ ) {
+    std::size_t const codes = out_.size ( );
+    out_.resize ( codes + 4 );
+    for ( int w = 0; w < 16; ++w ) {
+        std::uint32_t const x = x_[ w ];
+        int const code        = not x ? 0 : x < 0x100 ? 1 : x < 0x1'0000 ? 2 : 3;
+        out_[ codes + w / 4 ] |= static_cast<std::byte> ( code << ( 2 * ( w % 4 ) ) );
+        auto const bytes = reinterpret_cast<std::byte const *> ( x_ + w ); // little endian, low bytes first
+        out_.insert ( out_.end ( ), bytes, bytes + checkpoint_word_bytes[ code ] );
+    }
+}
+
+// the bytes of a compressed block (at least 4 bytes at in_)
+[[nodiscard]] inline std::size_t compressed_bytes ( std::byte const * in_ ) noexcept {
+    std::size_t bytes = 4;
+    for ( int w = 0; w < 16; ++w )
+        bytes += checkpoint_word_bytes[ ( static_cast<int> ( in_[ w / 4 ] ) >> ( 2 * ( w % 4 ) ) ) & 3 ];
+    return bytes;
+}
+
+[[nodiscard]] inline std::byte const * decompress_block ( std::byte const * in_, std::uint32_t * x_ ) noexcept {
+    std::byte const * bytes = in_ + 4;
+    for ( int w = 0; w < 16; ++w ) {
+        int const code = ( static_cast<int> ( in_[ w / 4 ] ) >> ( 2 * ( w % 4 ) ) ) & 3;
+        x_[ w ]        = 0;
+        std::memcpy ( x_ + w, bytes, checkpoint_word_bytes[ code ] );
+        bytes += checkpoint_word_bytes[ code ];
+    }
+    return bytes;
+}
+
+#if defined( _WIN32 )
+inline void sync_file ( std::filesystem::path const & path_ ) {
+    HANDLE file = CreateFileW ( path_.c_str ( ), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL, nullptr );
+    bool const synced = file != INVALID_HANDLE_VALUE and FlushFileBuffers ( file );
+    if ( file != INVALID_HANDLE_VALUE )
+        CloseHandle ( file );
+    if ( not synced )
+        throw std::runtime_error ( "checkpoint: cannot flush " + path_.string ( ) );
+}
+// the rename is on the device when it returns
+inline void sync_rename ( std::filesystem::path const & from_, std::filesystem::path const & to_ ) {
+    if ( not MoveFileExW ( from_.c_str ( ), to_.c_str ( ), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH ) )
+        throw std::runtime_error ( "checkpoint: cannot rename " + from_.string ( ) );
+}
+#else
+// a directory too, f.e. after a rename in it
+inline void sync_file ( std::filesystem::path const & path_ ) {
+    int const fd      = open ( path_.c_str ( ), O_RDONLY | O_CLOEXEC );
+    bool const synced = fd >= 0 and not fsync ( fd );
+    if ( fd >= 0 )
+        close ( fd );
+    if ( not synced )
+        throw std::runtime_error ( "checkpoint: cannot flush " + path_.string ( ) );
+}
+// the rename is on the device when it returns
+inline void sync_rename ( std::filesystem::path const & from_, std::filesystem::path const & to_ ) {
+    std::filesystem::rename ( from_, to_ );
+    sync_file ( to_.has_parent_path ( ) ? to_.parent_path ( ) : std::filesystem::path ( "." ) );
+}
+#endif
+
+inline void write_checkpoint_file ( std::filesystem::path const & path_, checkpoint_header const & header_,
+                                    std::initializer_list<std::pair<void const *, std::size_t>> parts_ ) {
+    std::filesystem::path tmp = path_;
+    tmp += ".tmp";
+    {
+        std::ofstream stream ( tmp, std::ios::binary | std::ios::trunc );
+        stream.write ( reinterpret_cast<char const *> ( &header_ ), sizeof ( header_ ) );
+        for ( auto const & [ data, size ] : parts_ )
+            stream.write ( static_cast<char const *> ( data ), static_cast<std::streamsize> ( size ) );
+        if ( not stream.flush ( ) )
+            throw std::runtime_error ( "checkpoint: cannot write " + tmp.string ( ) );
+    }
+    sync_file ( tmp );
+    sync_rename ( tmp, path_ );
+}
+
+} // namespace detail
+
+// checkpoint_writer
+//
+//   save ( ) copies the state and returns, the writer thread writes the latest copy (checkpoints saved faster than they can
+//   be written are skipped, only the latest counts). Errors on the writer thread are rethrown by the next save ( ) or
+//   flush ( ).
+//
+class checkpoint_writer {
+
+    public:
+    struct parameters {
+        std::filesystem::path directory;
+        std::size_t bytes;                  // of the state
+        int rebase_period     = 100;        // checkpoints, 0 rebases only on the size of the delta
+        float rebase_fraction = 0.5f;       // of the state, the largest delta
+    };
+
+    explicit checkpoint_writer ( parameters const & parameters_ ) :
+        m_parameters ( parameters_ ), m_blocks ( detail::checkpoint_padded ( parameters_.bytes ) / detail::checkpoint_block ),
+        m_base ( m_blocks * detail::checkpoint_block ), m_pending ( m_base.size ( ) ), m_working ( m_base.size ( ) ) {
+        std::filesystem::create_directories ( m_parameters.directory );
+        m_writer = std::jthread ( [ this ] ( std::stop_token stop_ ) { write_back ( stop_ ); } );
+    }
+
+    checkpoint_writer ( checkpoint_writer const & ) = delete;
+    checkpoint_writer & operator= ( checkpoint_writer const & ) = delete;
+
+    ~checkpoint_writer ( ) {
+        {
+            std::scoped_lock lock ( m_mutex ); // not between the check of the predicate and the wait
+            m_writer.request_stop ( );
+        }
+        m_work.notify_one ( );
+        m_writer.join ( ); // writes the pending checkpoint
+    }
+
+    // state_ points to parameters.bytes bytes
+    void save ( void const * state_ ) {
+        {
+            std::scoped_lock lock ( m_mutex );
+            rethrow ( );
+            std::memcpy ( m_pending.data ( ), state_, m_parameters.bytes );
+            m_has_pending = true;
+        }
+        m_work.notify_one ( );
+    }
+
+    // waits until the saved checkpoints are written
+    void flush ( ) {
+        std::unique_lock lock ( m_mutex );
+        m_idle.wait ( lock, [ this ] { return not m_has_pending and not m_busy; } );
+        rethrow ( );
+    }
+
+    [[nodiscard]] std::uint64_t written ( ) const noexcept { return m_written.load ( std::memory_order_acquire ); }
+
+    private:
+    void rethrow ( ) {
+        if ( m_error )
+            std::rethrow_exception ( std::exchange ( m_error, nullptr ) );
+    }
+
+    void write_back ( std::stop_token stop_ ) {
+        std::unique_lock lock ( m_mutex );
+        while ( true ) {
+            m_work.wait ( lock, [ & ] { return stop_.stop_requested ( ) or m_has_pending; } );
+            if ( not m_has_pending )
+                return; // stop requested, all written
+            std::swap ( m_pending, m_working );
+            m_has_pending = false;
+            m_busy        = true;
+            lock.unlock ( );
+            try {
+                write ( );
+            }
+            catch ( ... ) {
+                lock.lock ( );
+                m_error = std::current_exception ( );
+                lock.unlock ( );
+            }
+            lock.lock ( );
+            m_busy = false;
+            m_idle.notify_all ( );
+        }
+    }
+
+    void write ( ) {
+        ++m_sequence;
+        auto const period     = static_cast<std::uint64_t> ( m_parameters.rebase_period );
+        bool const rebase_due = m_parameters.rebase_period > 0 and not ( ( m_sequence - m_base_sequence ) % period );
+        if ( m_base_sequence and not rebase_due and write_delta ( ) ) {
+            m_written.store ( m_sequence, std::memory_order_release );
+            return;
+        }
+        detail::checkpoint_header h{ };
+        std::memcpy ( h.magic, detail::checkpoint_base_magic, sizeof ( h.magic ) );
+        h.version = detail::checkpoint_version, h.bytes = m_parameters.bytes, h.base = h.sequence = m_sequence;
+        detail::write_checkpoint_file ( m_parameters.directory / "base", h, { { m_working.data ( ), m_parameters.bytes } } );
+        std::filesystem::remove ( m_parameters.directory / "delta" ); // refers to the old base
+        std::swap ( m_base, m_working );
+        m_base_sequence = m_sequence;
+        m_written.store ( m_sequence, std::memory_order_release );
+    }
+
+    // false if the delta is too large (a base should be written instead)
+    [[nodiscard]] bool write_delta ( ) {
+        std::size_t const limit = static_cast<std::size_t> ( m_parameters.rebase_fraction * m_parameters.bytes );
+        m_indices.clear ( );
+        m_payload.clear ( );
+        alignas ( 64 ) std::uint32_t x[ 16 ];
+        for ( std::uint32_t b = 0; b < m_blocks; ++b ) {
+#if defined( __AVX2__ )
+            auto const base = reinterpret_cast<__m256i const *> ( m_base.data ( ) + b * detail::checkpoint_block );
+            auto const now  = reinterpret_cast<__m256i const *> ( m_working.data ( ) + b * detail::checkpoint_block );
+            __m256i const x0 = _mm256_xor_si256 ( _mm256_load_si256 ( base ), _mm256_load_si256 ( now ) );
+            __m256i const x1 = _mm256_xor_si256 ( _mm256_load_si256 ( base + 1 ), _mm256_load_si256 ( now + 1 ) );
+            if ( _mm256_testz_si256 ( _mm256_or_si256 ( x0, x1 ), _mm256_or_si256 ( x0, x1 ) ) )
+                continue; // unchanged
+            _mm256_store_si256 ( reinterpret_cast<__m256i *> ( x ), x0 );
+            _mm256_store_si256 ( reinterpret_cast<__m256i *> ( x + 8 ), x1 );
+#else
+            auto const base = reinterpret_cast<__m128i const *> ( m_base.data ( ) + b * detail::checkpoint_block );
+            auto const now  = reinterpret_cast<__m128i const *> ( m_working.data ( ) + b * detail::checkpoint_block );
+            __m128i d[ 4 ];
+            for ( int i = 0; i < 4; ++i )
+                d[ i ] = _mm_xor_si128 ( _mm_load_si128 ( base + i ), _mm_load_si128 ( now + i ) );
+            __m128i const any = _mm_or_si128 ( _mm_or_si128 ( d[ 0 ], d[ 1 ] ), _mm_or_si128 ( d[ 2 ], d[ 3 ] ) );
+            if ( _mm_testz_si128 ( any, any ) )
+                continue; // unchanged
+            for ( int i = 0; i < 4; ++i )
+                _mm_store_si128 ( reinterpret_cast<__m128i *> ( x + 4 * i ), d[ i ] );
+#endif
+            m_indices.push_back ( b );
+            detail::compress_block ( x, m_payload );
+            if ( m_payload.size ( ) + m_indices.size ( ) * sizeof ( std::uint32_t ) > limit )
+                return false;
+        }
+        detail::checkpoint_header h{ };
+        std::memcpy ( h.magic, detail::checkpoint_delta_magic, sizeof ( h.magic ) );
+        h.version = detail::checkpoint_version, h.blocks = static_cast<std::uint32_t> ( m_indices.size ( ) );
+        h.bytes = m_parameters.bytes, h.base = m_base_sequence, h.sequence = m_sequence, h.payload = m_payload.size ( );
+        detail::write_checkpoint_file ( m_parameters.directory / "delta", h,
+                                        { { m_indices.data ( ), m_indices.size ( ) * sizeof ( std::uint32_t ) },
+                                          { m_payload.data ( ), m_payload.size ( ) } } );
+        return true;
+    }
+
+    parameters m_parameters;
+    std::uint32_t m_blocks;
+    aligned_vector<std::byte> m_base, m_pending, m_working;
+    std::vector<std::uint32_t> m_indices;
+    std::vector<std::byte> m_payload;
+    std::uint64_t m_sequence = 0, m_base_sequence = 0; // writer owned
+    std::atomic<std::uint64_t> m_written = 0;         // the sequence of the last checkpoint written, for written ( )
+
+    bool m_has_pending = false, m_busy = false;
+    std::exception_ptr m_error;
+    std::mutex m_mutex;
+    std::condition_variable m_work, m_idle;
+    std::jthread m_writer;
+};
+
+// Restores the latest checkpoint in directory_ into state_ (bytes_ bytes), returns false if there is none.
+inline bool restore_checkpoint ( std::filesystem::path const & directory_, void * state_, std::size_t bytes_ ) {
+    auto read = [ bytes_ ] ( std::filesystem::path const & path_, char const * magic_, detail::checkpoint_header & h_,
+                             std::vector<std::byte> & data_ ) {
+        std::ifstream stream ( path_, std::ios::binary );
+        if ( not stream )
+            return false;
+        if ( not stream.read ( reinterpret_cast<char *> ( &h_ ), sizeof ( h_ ) ) or std::memcmp ( h_.magic, magic_, 8 ) or
+             h_.version != detail::checkpoint_version or h_.bytes != bytes_ )
+            throw std::runtime_error ( "restore_checkpoint: " + path_.string ( ) + " is not a checkpoint of this state" );
+        data_.assign ( std::filesystem::file_size ( path_ ) - sizeof ( h_ ), std::byte{ } );
+        if ( not stream.read ( reinterpret_cast<char *> ( data_.data ( ) ), static_cast<std::streamsize> ( data_.size ( ) ) ) )
+            throw std::runtime_error ( "restore_checkpoint: cannot read " + path_.string ( ) );
+        return true;
+    };
+    detail::checkpoint_header base, delta;
+    std::vector<std::byte> base_data, delta_data;
+    if ( not read ( directory_ / "base", detail::checkpoint_base_magic, base, base_data ) )
+        return false;
+    if ( base_data.size ( ) != bytes_ )
+        throw std::runtime_error ( "restore_checkpoint: " + ( directory_ / "base" ).string ( ) + " is truncated" );
+    base_data.resize ( detail::checkpoint_padded ( bytes_ ) );
+    if ( read ( directory_ / "delta", detail::checkpoint_delta_magic, delta, delta_data ) and delta.base == base.sequence ) {
+        auto const corrupt = [ & ] {
+            return std::runtime_error ( "restore_checkpoint: " + ( directory_ / "delta" ).string ( ) + " is corrupt" );
+        };
+        if ( delta_data.size ( ) != std::uint64_t{ delta.blocks } * sizeof ( std::uint32_t ) + delta.payload )
+            throw corrupt ( );
+        std::size_t const blocks    = base_data.size ( ) / detail::checkpoint_block;
+        auto const indices          = reinterpret_cast<std::uint32_t const *> ( delta_data.data ( ) );
+        std::byte const * payload   = delta_data.data ( ) + delta.blocks * sizeof ( std::uint32_t );
+        std::byte const * const end = delta_data.data ( ) + delta_data.size ( );
+        std::uint32_t x[ 16 ], y[ 16 ];
+        for ( std::uint32_t i = 0; i < delta.blocks; ++i ) {
+            if ( indices[ i ] >= blocks or end - payload < 4 or
+                 static_cast<std::size_t> ( end - payload ) < detail::compressed_bytes ( payload ) )
+                throw corrupt ( );
+            std::byte * block = base_data.data ( ) + std::size_t{ indices[ i ] } * detail::checkpoint_block;
+            payload           = detail::decompress_block ( payload, x );
+            std::memcpy ( y, block, sizeof ( y ) );
+            for ( int w = 0; w < 16; ++w )
+                y[ w ] ^= x[ w ];
+            std::memcpy ( block, y, sizeof ( y ) );
+        }
+    }
+    std::memcpy ( state_, base_data.data ( ), bytes_ );
+    return true;
+}
+
+TD_LEARNING_END_TARGET
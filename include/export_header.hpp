@@ -0,0 +1,144 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <ios>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include "activation.hpp"
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+// Writes a C++ header evaluating a trained cascade_network without any library, scratch object or initialization: the
+// weights are 'constexpr alignas ( 64 )' arrays and the forward pass is unrolled into one expression per neuron for this
+// exact shape. The constant (bias) inputs are summed into one constant per neuron and alpha is folded into the weights
+// (alpha is a power of 2, so the products are exact), the compiler sees all of it and schedules the whole cascade.
+//
+//       std::ofstream header ( "evaluator.hpp" );
+//       export_header ( header, "evaluator", network );
+//
+//       #include "evaluator.hpp"
+//       std::array<float, evaluator::num_output> y = evaluator::evaluate ( x );
+
+namespace detail {
+
+[[nodiscard]] inline std::string float_literal ( float f_ ) {
+    std::ostringstream s;
+    s << std::hexfloat << f_ << 'f'; // exact
+    return s.str ( );
+}
+
+} // namespace detail
+
+// the generated form of an activation policy (see activation.hpp)
+struct exported_activation {
+    std::string source;
+    bool is_layer = false, constant = true;
+};
+
+template<typename Activation>
+[[nodiscard]] exported_activation export_activation ( ) {
+    return { Activation::source ( ), Activation::is_layer, Activation::constant };
+}
+
+// shape_ is NumInput, NumOnes, NumOutput, NumNeurons, weights_ the NumWeights weights, alpha_ the scale of the net input
+inline void export_header ( std::ostream & out_, std::string_view name_, std::array<std::int32_t, 4> const & shape_,
+                            float const * weights_, float alpha_,
+                            exported_activation const & hidden_ = export_activation<activation::rectifier> ( ),
+                            exported_activation const & output_ = export_activation<activation::rectifier> ( ) ) {
+    auto const [ num_input, num_ones, num_output, num_neurons ] = shape_;
+    int const num_inp = num_input + num_ones;
+    auto const weight = [ & ] ( int n_, int i_ ) { return weights_[ n_ * num_inp + n_ * ( n_ - 1 ) / 2 + i_ ]; };
+
+    out_ << "\n// generated by export_header ( ), cascade_network<" << num_input << ", " << num_ones << ", " << num_output << ", "
+         << num_neurons << ">\n\n#pragma once\n\n"
+         << ( hidden_.constant and output_.constant ? "" : "#include <cmath>\n\n" ) << "#include <array>\n\nnamespace " << name_
+         << " {\n\n";
+    out_ << "inline constexpr int num_input = " << num_input << ", num_output = " << num_output << ", num_neurons = " << num_neurons
+         << ";\n\n";
+
+    // per neuron: alpha * ( the weights of the raw inputs, then those of the upstream neurons ), and the bias
+    out_ << "alignas ( 64 ) inline constexpr float bias[ num_neurons ] = {";
+    for ( int n = 0; n < num_neurons; ++n ) {
+        float b = 0.0f;
+        for ( int o = 0; o < num_ones; ++o )
+            b += weight ( n, num_input + o ); // the ones are 1
+        out_ << ( n ? ", " : " " ) << detail::float_literal ( alpha_ * b );
+    }
+    out_ << " };\n\n";
+    out_ << "alignas ( 64 ) inline constexpr float weights[ " << num_neurons * num_input + num_neurons * ( num_neurons - 1 ) / 2
+         << " ] = {\n";
+    for ( int n = 0; n < num_neurons; ++n ) {
+        out_ << "   ";
+        for ( int i = 0; i < num_input; ++i )
+            out_ << ' ' << detail::float_literal ( alpha_ * weight ( n, i ) ) << ',';
+        for ( int u = 0; u < n; ++u )
+            out_ << ' ' << detail::float_literal ( alpha_ * weight ( n, num_inp + u ) ) << ',';
+        out_ << " // neuron " << n << '\n';
+    }
+    out_ << "};\n\n";
+
+    // the output activation of a layer is the identity per neuron, its statements follow on the array of the outputs
+    auto const specifier = [] ( bool constant_ ) { return constant_ ? "constexpr" : "inline"; };
+    out_ << "[[nodiscard]] " << specifier ( hidden_.constant ) << " float hidden_activation ( float x_ ) noexcept { return "
+         << hidden_.source << "; }\n";
+    out_ << "[[nodiscard]] " << specifier ( output_.constant ) << " float output_activation ( float x_ ) noexcept { return "
+         << ( output_.is_layer ? std::string ( "x_" ) : output_.source ) << "; }\n\n";
+    out_ << "[[nodiscard]] " << specifier ( hidden_.constant and output_.constant )
+         << " std::array<float, num_output> evaluate ( std::array<float, num_input> const & x_ ) noexcept {\n";
+    int w = 0;
+    for ( int n = 0; n < num_neurons; ++n ) {
+        char const * const layer = n < num_neurons - num_output ? "hidden" : "output";
+        out_ << "    float const n" << n << " = " << layer << "_activation ( bias[ " << n << " ]";
+        for ( int i = 0; i < num_input; ++i, ++w )
+            out_ << "\n        + weights[ " << w << " ] * x_[ " << i << " ]";
+        for ( int u = 0; u < n; ++u, ++w )
+            out_ << "\n        + weights[ " << w << " ] * n" << u;
+        out_ << " );\n";
+    }
+    out_ << ( output_.is_layer ? "    std::array<float, num_output> y_ = {" : "    return {" );
+    for ( int o = 0; o < num_output; ++o )
+        out_ << ( o ? ", n" : " n" ) << num_neurons - num_output + o;
+    out_ << " };\n";
+    if ( output_.is_layer )
+        out_ << "    " << output_.source << "    return y_;\n";
+    out_ << "}\n\n} // namespace " << name_ << '\n';
+}
+
+template<typename Network>
+void export_header ( std::ostream & out_, std::string_view name_, Network const & network_ ) {
+    export_header ( out_, name_, Network::shape, network_.weights.data ( ), Network::alpha,
+                    export_activation<typename Network::hidden_activation> ( ),
+                    export_activation<typename Network::output_activation> ( ) );
+}
+
+TD_LEARNING_END_TARGET
@@ -0,0 +1,284 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <stop_token>
+#include <thread>
+#include <utility>
+
+#include "replay_buffer.hpp"
+#include "td_learning/mapped_file.hpp"
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+// mapped_replay_buffer
+//
+//   Replay backed by a file of fixed-size records, mapped into memory (capacity scales with disk, not DRAM). A push ( )
+//   writes the record straight into the mapping, every segment_size records the segment is handed to a background thread
+//   that writes it back to disk. Records are numbered in push order (record n is in slot n % capacity), the file header
+//   holds the range [ first, last ) of the durable ones: the writer advances last once a segment is on disk, and before the
+//   ring overwrites a durable record push ( ) moves first past the next segment_size records and writes the header back
+//   (one header write per segment), so after a crash the header never covers a torn record. Sampling gathers directly from
+//   the mapped records (no deserialization) and has the same interface as the in-memory replay_buffer. Re-opening an
+//   existing file is instant, its transitions start with equal priorities.
+//
+//   Errors of the writer thread are rethrown by the next push ( ), close_segment ( ) or flush ( ), the records pushed after
+//   a failed write are not made durable any more. The destructor writes the open segment back, but drops errors (call
+//   flush ( ) to see them).
+//
+template<int StateSize>
+class mapped_replay_buffer : public detail::replay_sampling<mapped_replay_buffer<StateSize>, StateSize> {
+
+    friend class detail::replay_sampling<mapped_replay_buffer, StateSize>;
+
+    struct record {
+        float state[ StateSize ], next_state[ StateSize ];
+        std::int32_t action;
+        float reward;
+        std::int32_t done;
+    };
+
+    struct header {
+        char magic[ 8 ];
+        std::uint32_t version, state_size, record_size, capacity;
+        std::uint64_t first, last; // the durable records
+    };
+
+    static constexpr char magic[ 8 ]          = { 'T', 'D', 'R', 'E', 'P', 'L', 'A', 'Y' };
+    static constexpr std::uint32_t version    = 2;
+    static constexpr std::size_t header_bytes = 4'096; // records start page aligned
+
+    public:
+    using transition_type = transition<StateSize>;
+    using batch_type      = replay_batch<StateSize>;
+
+    struct parameters {
+        std::filesystem::path path;
+        int capacity, segment_size = 4'096; // in records
+        float alpha = 0.6f, epsilon = 1e-6f; // priority = ( | td-error | + epsilon ) ^ alpha
+    };
+
+    explicit mapped_replay_buffer ( parameters const & parameters_ ) :
+        detail::replay_sampling<mapped_replay_buffer, StateSize> ( parameters_.capacity, parameters_.alpha, parameters_.epsilon ),
+        m_parameters ( parameters_ ),
+        m_file ( parameters_.path, mapped_file::access::read_write, header_bytes + parameters_.capacity * sizeof ( record ) ) {
+        header & h = file_header ( );
+        if ( std::memcmp ( h.magic, magic, sizeof ( magic ) ) ) { // new file
+            std::memcpy ( h.magic, magic, sizeof ( magic ) );
+            h.version = version, h.state_size = StateSize, h.record_size = sizeof ( record );
+            h.capacity = static_cast<std::uint32_t> ( capacity ( ) );
+            h.first = h.last = 0;
+            m_file.flush ( 0, sizeof ( header ) );
+        }
+        else if ( h.version != version or h.state_size != StateSize or h.record_size != sizeof ( record ) or
+                  h.capacity != static_cast<std::uint32_t> ( capacity ( ) ) or h.first > h.last or
+                  h.last - h.first > static_cast<std::uint64_t> ( capacity ( ) ) ) {
+            throw std::runtime_error ( "mapped_replay_buffer: " + parameters_.path.string ( ) + " has a different layout" );
+        }
+        m_first = m_invalidated = h.first, m_pushed = m_segment = h.last;
+        for ( int k = 0; k < size ( ); ++k )
+            this->prioritize ( slot ( k ) );
+        m_file.advise ( mapped_file::advice::random );
+        m_writer = std::jthread ( [ this ] ( std::stop_token stop_ ) { write_back ( stop_ ); } );
+    }
+
+    mapped_replay_buffer ( mapped_replay_buffer const & ) = delete;
+    mapped_replay_buffer & operator= ( mapped_replay_buffer const & ) = delete;
+
+    ~mapped_replay_buffer ( ) noexcept {
+        try {
+            close_segment ( );
+        }
+        catch ( ... ) {
+        }
+        {
+            std::scoped_lock lock ( m_mutex ); // not between the check of the predicate and the wait
+            m_writer.request_stop ( );
+        }
+        m_work.notify_one ( );
+        m_writer.join ( ); // drains the queue
+    }
+
+    [[nodiscard]] int capacity ( ) const noexcept { return m_parameters.capacity; }
+    [[nodiscard]] int size ( ) const noexcept { return static_cast<int> ( m_pushed - m_first ); }
+    [[nodiscard]] bool empty ( ) const noexcept { return m_pushed == m_first; }
+
+    void push ( transition_type const & t_ ) {
+        if ( m_failed.load ( std::memory_order_relaxed ) ) {
+            std::scoped_lock lock ( m_mutex );
+            rethrow ( );
+        }
+        if ( size ( ) == capacity ( ) ) { // overwrites the oldest record
+            if ( m_first >= m_invalidated )
+                invalidate ( std::min ( m_first + m_parameters.segment_size, m_pushed ) );
+            ++m_first;
+        }
+        int const i = static_cast<int> ( m_pushed % capacity ( ) );
+        record & r  = records ( )[ i ];
+        std::memcpy ( r.state, t_.state.data ( ), StateSize * sizeof ( float ) );
+        std::memcpy ( r.next_state, t_.next_state.data ( ), StateSize * sizeof ( float ) );
+        r.action = t_.action;
+        r.reward = t_.reward;
+        r.done   = t_.done;
+        this->prioritize ( i );
+        ++m_pushed;
+        if ( not ( m_pushed % capacity ( ) ) or m_pushed - m_segment == static_cast<std::uint64_t> ( m_parameters.segment_size ) )
+            close_segment ( );
+    }
+
+    void push ( std::span<transition_type const> transitions_ ) {
+        for ( auto const & t : transitions_ )
+            push ( t );
+    }
+
+    // hands the records pushed since the last segment to the writer
+    void close_segment ( ) {
+        {
+            std::scoped_lock lock ( m_mutex );
+            rethrow ( );
+            if ( m_pushed == m_segment )
+                return;
+            m_segments.push_back ( { m_segment, m_pushed } );
+        }
+        m_work.notify_one ( );
+        m_segment = m_pushed;
+    }
+
+    // waits until the closed segments are written
+    void flush ( ) {
+        std::unique_lock lock ( m_mutex );
+        m_idle.wait ( lock, [ this ] { return m_segments.empty ( ) and not m_busy; } );
+        rethrow ( );
+    }
+
+    private:
+    struct segment {
+        std::uint64_t begin, end; // record numbers, within one lap of the ring
+    };
+
+    [[nodiscard]] header & file_header ( ) noexcept { return *reinterpret_cast<header *> ( m_file.data ( ) ); }
+    [[nodiscard]] record * records ( ) noexcept { return reinterpret_cast<record *> ( m_file.data ( ) + header_bytes ); }
+    [[nodiscard]] record const * records ( ) const noexcept {
+        return reinterpret_cast<record const *> ( m_file.data ( ) + header_bytes );
+    }
+
+    // under m_mutex
+    void rethrow ( ) {
+        if ( m_error ) {
+            m_failed.store ( false, std::memory_order_relaxed );
+            std::rethrow_exception ( std::exchange ( m_error, nullptr ) );
+        }
+    }
+
+    // drops the records before first_ from the durable range, before they are overwritten
+    void invalidate ( std::uint64_t first_ ) {
+        std::scoped_lock lock ( m_header_mutex );
+        header & h = file_header ( );
+        h.first    = first_;
+        h.last     = std::max ( h.last, first_ );
+        m_file.flush ( 0, sizeof ( header ) );
+        m_invalidated = first_;
+    }
+
+    void write_back ( std::stop_token stop_ ) {
+        std::unique_lock lock ( m_mutex );
+        bool broken = false; // a segment is not on disk, the durable range can't grow past it
+        while ( true ) {
+            m_work.wait ( lock, [ & ] { return stop_.stop_requested ( ) or not m_segments.empty ( ); } );
+            if ( m_segments.empty ( ) )
+                return; // stop requested, all written
+            segment const s = m_segments.front ( );
+            m_segments.pop_front ( );
+            m_busy = true;
+            lock.unlock ( );
+            try {
+                if ( not broken ) {
+                    std::size_t const begin = s.begin % capacity ( );
+                    m_file.flush ( header_bytes + begin * sizeof ( record ), ( s.end - s.begin ) * sizeof ( record ) );
+                    std::scoped_lock header_lock ( m_header_mutex );
+                    header & h = file_header ( );
+                    h.last     = std::max ( h.last, s.end );
+                    m_file.flush ( 0, sizeof ( header ) );
+                }
+            }
+            catch ( ... ) {
+                broken = true;
+                lock.lock ( );
+                m_error = std::current_exception ( );
+                m_failed.store ( true, std::memory_order_relaxed );
+                lock.unlock ( );
+            }
+            lock.lock ( );
+            m_busy = false;
+            m_idle.notify_all ( );
+        }
+    }
+
+    // the k-th oldest live record
+    [[nodiscard]] int slot ( int k_ ) const noexcept { return static_cast<int> ( ( m_first + k_ ) % capacity ( ) ); }
+
+    void gather ( batch_type & batch_ ) const noexcept {
+        float * states = batch_.states.data ( ), * next_states = batch_.next_states.data ( );
+        for ( int b = 0; b < batch_.size ( ); ++b, states += StateSize, next_states += StateSize ) {
+            record const & r = records ( )[ batch_.indices[ b ] ];
+            std::memcpy ( states, r.state, StateSize * sizeof ( float ) );
+            std::memcpy ( next_states, r.next_state, StateSize * sizeof ( float ) );
+            batch_.actions[ b ] = r.action;
+            batch_.rewards[ b ] = r.reward;
+            batch_.dones[ b ]   = static_cast<float> ( r.done );
+        }
+    }
+
+    parameters m_parameters;
+    mapped_file m_file;
+
+    std::uint64_t m_first = 0, m_pushed = 0; // the live records, [ m_first, m_pushed )
+    std::uint64_t m_segment     = 0;         // the first record of the open segment
+    std::uint64_t m_invalidated = 0;         // the first durable record, as of the last invalidate ( )
+
+    std::deque<segment> m_segments;
+    bool m_busy = false;
+    std::exception_ptr m_error;
+    std::atomic<bool> m_failed = false; // m_error is set
+    std::mutex m_mutex, m_header_mutex;
+    std::condition_variable m_work, m_idle;
+    std::jthread m_writer;
+};
+
+TD_LEARNING_END_TARGET
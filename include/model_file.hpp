@@ -0,0 +1,138 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#include <cereal/archives/binary.hpp>
+
+#include "td_learning/mapped_file.hpp"
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+// Saving and loading a Network (a cascade_network). Two formats:
+//
+//   - cereal binary archives (versioned, checked against the shape of the Network), save_model ( ) and load_model ( ).
+//
+//   - a raw image, a 64-byte header followed by the weights (so 64-byte aligned in a mapping), in the byte order of the
+//     writer. write_model_image ( ) writes it, a mapped_model maps it read-only and hands out a pointer to the weights in
+//     the mapping, to pass straight to Network::feed_forward ( const_pointer ). Nothing is copied or parsed, so a process
+//     starts serving after one page fault per page touched, and all processes mapping the same image share its pages.
+//
+//       mapped_model<network> model ( "model.tdm" );
+//       network net ( rng );                            // scratch space, its own weights are not used
+//       net.feed_forward ( model.weights ( ) );
+
+template<typename Network>
+void save_model ( Network const & network_, std::filesystem::path const & path_ ) {
+    std::ofstream stream ( path_, std::ios::binary );
+    if ( not stream )
+        throw std::runtime_error ( "save_model: cannot open " + path_.string ( ) );
+    cereal::BinaryOutputArchive archive ( stream );
+    archive ( network_ );
+}
+
+template<typename Network>
+void load_model ( Network & network_, std::filesystem::path const & path_ ) {
+    std::ifstream stream ( path_, std::ios::binary );
+    if ( not stream )
+        throw std::runtime_error ( "load_model: cannot open " + path_.string ( ) );
+    cereal::BinaryInputArchive archive ( stream );
+    archive ( network_ );
+}
+
+namespace detail {
+
+struct alignas ( 64 ) model_image_header {
+    char magic[ 8 ];
+    std::uint32_t version, byte_order; // byte_order reads 0x01020304 if the reader's byte order matches
+    std::int32_t shape[ 4 ];            // NumInput, NumOnes, NumOutput, NumNeurons
+    std::uint64_t weights;              // count
+    std::uint8_t reserved[ 24 ];
+};
+
+static_assert ( sizeof ( model_image_header ) == 64 );
+
+inline constexpr char model_image_magic[ 8 ]         = { 'T', 'D', 'M', 'O', 'D', 'E', 'L', 0 };
+inline constexpr std::uint32_t model_image_version    = 1;
+inline constexpr std::uint32_t model_image_byte_order = 0x0102'0304;
+
+template<typename Network>
+[[nodiscard]] model_image_header make_model_image_header ( ) noexcept {
+    model_image_header h{ };
+    std::memcpy ( h.magic, model_image_magic, sizeof ( model_image_magic ) );
+    h.version = model_image_version, h.byte_order = model_image_byte_order;
+    std::memcpy ( h.shape, Network::shape.data ( ), sizeof ( h.shape ) );
+    h.weights = Network::NumWeights;
+    return h;
+}
+
+} // namespace detail
+
+template<typename Network>
+void write_model_image ( Network const & network_, std::filesystem::path const & path_ ) {
+    std::ofstream stream ( path_, std::ios::binary );
+    if ( not stream )
+        throw std::runtime_error ( "write_model_image: cannot open " + path_.string ( ) );
+    detail::model_image_header const h = detail::make_model_image_header<Network> ( );
+    stream.write ( reinterpret_cast<char const *> ( &h ), sizeof ( h ) );
+    stream.write ( reinterpret_cast<char const *> ( network_.weights.data ( ) ), sizeof ( network_.weights ) );
+    if ( not stream )
+        throw std::runtime_error ( "write_model_image: cannot write " + path_.string ( ) );
+}
+
+// mapped_model
+//
+//   A model image mapped read-only, checked against the shape of the Network.
+//
+template<typename Network>
+class mapped_model {
+
+    public:
+    using const_pointer = typename Network::const_pointer;
+
+    explicit mapped_model ( std::filesystem::path const & path_ ) : m_file ( path_, mapped_file::access::read_only ) {
+        detail::model_image_header const expected = detail::make_model_image_header<Network> ( );
+        if ( m_file.size ( ) < sizeof ( expected ) + sizeof ( typename Network::wgt_type ) or
+             std::memcmp ( m_file.data ( ), &expected, sizeof ( expected ) ) )
+            throw std::runtime_error ( "mapped_model: " + path_.string ( ) + " is not an image of this network" );
+        m_file.advise ( mapped_file::advice::will_need );
+    }
+
+    [[nodiscard]] const_pointer weights ( ) const noexcept {
+        return reinterpret_cast<const_pointer> ( m_file.data ( ) + sizeof ( detail::model_image_header ) );
+    }
+
+    private:
+    mapped_file m_file;
+};
+
+TD_LEARNING_END_TARGET
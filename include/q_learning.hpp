@@ -0,0 +1,138 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+#include "autotune.hpp"
+#include "cascade_network.hpp"
+#include "replay_buffer.hpp"
+#include "target_network.hpp"
+#include "td_learning/aligned_allocator.hpp"
+#include "td_learning/detail/simd_blas.inl"
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+// q_learner
+//
+//   Q-learning (Watkins, 1989, see doc/qlearning.pdf) with a cascade_network as the action-value function, the NumOutput
+//   outputs are the values of the actions. Updates are on mini-batches (f.e. sampled from a replay_buffer), the targets
+//   r + gamma * max_a Q' ( s', a ) of the whole batch come out of one batched forward pass of the next states through the
+//   target network Q' (a shadow copy of the weights, see target_network) and a vectorized max over the padded
+//   out arrays. The gradients of the batch are accumulated, then applied at once. Batches are of parameters.batch_size.
+//
+//   The outputs are unbounded values, so the output activation of the network needs to be activation::identity (the
+//   cascade_network default, rectifier, would clamp Q at 0 and break the targets of negative returns):
+//
+//       using network = cascade_network<8, 1, 4, 32, activation::rectifier, activation::identity>;
+//
+//       learner.update ( batch );
+//       replay.update_priorities ( batch.indices, learner.td_errors ( ) );
+//
+template<typename Network>
+class q_learner {
+
+    static_assert ( std::is_same_v<typename Network::output_activation, activation::identity>,
+                    "q_learner: the action values are unbounded, the output activation needs to be activation::identity" );
+
+    public:
+    using batch_type = replay_batch<Network::NumRaw>;
+    using wgt_type   = typename Network::wgt_type;
+
+    struct parameters {
+        int batch_size;
+        float gamma = 0.99f, learning_rate = 0.001f;
+        int target_period = 1'000; // updates between target syncs (0 syncs every update)
+        float tau         = 0.0f;  // if > 0, soft (Polyak) target updates every update instead
+        bool autotune     = false; // times the forward kernels on construction (see autotune.hpp), else cblas_sgemv
+    };
+
+    q_learner ( Network & network_, parameters const & parameters_ ) :
+        m_network ( network_ ), m_parameters ( parameters_ ),
+        m_kernel ( parameters_.autotune ? autotune_forward ( network_, parameters_.batch_size ) : forward_kernel::gemv ),
+        m_target ( network_.weights, { parameters_.tau, parameters_.target_period } ), m_states ( parameters_.batch_size ),
+        m_next_states ( parameters_.batch_size ), m_targets ( parameters_.batch_size ), m_td_errors ( parameters_.batch_size ) {}
+
+    // one gradient step on batch_ (of parameters.batch_size), returns the mean squared (importance weighted) td-error
+    float update ( batch_type const & batch_ ) {
+        int const size = batch_.size ( );
+        if ( size != m_parameters.batch_size )
+            throw std::runtime_error ( "q_learner: the batch size differs from parameters.batch_size" );
+        load ( m_next_states, batch_.next_states.data ( ), size );
+        load ( m_states, batch_.states.data ( ), size );
+        m_network.feed_forward ( m_next_states, m_target.data ( ), m_kernel );
+        m_network.feed_forward ( m_states, m_network.weights.data ( ), m_kernel );
+        for ( int b = 0; b < size; ++b )
+            m_targets[ b ] = horizontal_max_ps ( m_next_states.out_padded ( b ), Network::batch_type::NumOutPadded );
+        for ( int b = 0; b < size; ++b ) // vectorizes
+            m_targets[ b ] = batch_.rewards[ b ] + m_parameters.gamma * ( 1.0f - batch_.dones[ b ] ) * m_targets[ b ];
+        m_gradient.fill ( 0.0f );
+        float loss = 0.0f;
+        for ( int b = 0; b < size; ++b ) {
+            int const a      = batch_.actions[ b ];
+            m_td_errors[ b ] = m_states.out ( b )[ a ] - m_targets[ b ];
+            float const e    = batch_.weights[ b ] * m_td_errors[ b ];
+            loss += e * m_td_errors[ b ];
+            m_network.accumulate_gradient ( m_states.data ( b ), a, e, m_network.weights.data ( ), m_gradient.data ( ) );
+        }
+        float const step = -m_parameters.learning_rate / size;
+        axpy_ps ( m_network.weights.data ( ), step, m_gradient.data ( ), Network::NumWeights );
+        m_target.update ( m_network.weights );
+        ++m_updates;
+        return loss / size;
+    }
+
+    void sync_target ( ) noexcept { m_target.sync ( m_network.weights ); }
+
+    // of the last update, per sample of the batch (for replay_buffer::update_priorities)
+    [[nodiscard]] std::span<float const> td_errors ( ) const noexcept { return m_td_errors; }
+    [[nodiscard]] wgt_type const & target ( ) const noexcept { return m_target.weights ( ); }
+    [[nodiscard]] std::int64_t updates ( ) const noexcept { return m_updates; }
+    [[nodiscard]] forward_kernel kernel ( ) const noexcept { return m_kernel; }
+
+    private:
+    static void load ( typename Network::batch_type & space_, float const * states_, int size_ ) noexcept {
+        for ( int b = 0; b < size_; ++b, states_ += Network::NumRaw )
+            std::memcpy ( space_.raw ( b ).data ( ), states_, Network::NumRaw * sizeof ( float ) );
+    }
+
+    Network & m_network;
+    parameters m_parameters;
+    forward_kernel m_kernel;
+    target_network<Network> m_target;
+    wgt_type m_gradient;
+    typename Network::batch_type m_states, m_next_states;
+    aligned_vector<float> m_targets, m_td_errors;
+    std::int64_t m_updates = 0;
+};
+
+TD_LEARNING_END_TARGET
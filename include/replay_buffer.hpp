@@ -0,0 +1,280 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <array>
+#include <random>
+#include <span>
+
+#include "td_learning/aligned_allocator.hpp"
+#include "td_learning/rng.hpp"
+#include "td_learning/state_encoding.hpp"
+#include "td_learning/sum_tree.hpp"
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+template<int StateSize>
+struct transition {
+    std::array<float, StateSize> state;
+    int action;
+    float reward;
+    std::array<float, StateSize> next_state;
+    bool done;
+};
+
+// replay_batch
+//
+//   A mini-batch gathered from a replay buffer, every field contiguous (states row-major, StateSize floats per row) and
+//   64-byte aligned, ready for batched forward and backward passes.
+//
+template<int StateSize>
+struct replay_batch {
+
+    explicit replay_batch ( int size_ ) :
+        states ( size_ * StateSize ), next_states ( size_ * StateSize ), actions ( size_ ), rewards ( size_ ), dones ( size_ ),
+        weights ( size_, 1.0f ), indices ( size_ ) {}
+
+    [[nodiscard]] int size ( ) const noexcept { return static_cast<int> ( actions.size ( ) ); }
+
+    [[nodiscard]] std::span<float const, StateSize> state ( int i_ ) const noexcept {
+        return std::span<float const, StateSize> ( states.data ( ) + i_ * StateSize, StateSize );
+    }
+    [[nodiscard]] std::span<float const, StateSize> next_state ( int i_ ) const noexcept {
+        return std::span<float const, StateSize> ( next_states.data ( ) + i_ * StateSize, StateSize );
+    }
+
+    aligned_vector<float> states, next_states;
+    aligned_vector<int> actions;
+    aligned_vector<float> rewards, dones; // dones is 1.0f for terminal transitions, 0.0f otherwise
+    aligned_vector<float> weights;        // importance-sampling weights (1.0f for uniform sampling)
+    aligned_vector<int> indices;          // slots in the replay buffer, for update_priorities ( )
+};
+
+namespace detail {
+
+// Sampling shared by the replay buffers, Derived provides size ( ), slot ( k ) (the slot of the k-th oldest live transition)
+// and gather ( batch_type & ) (transitions at batch.indices).
+template<typename Derived, int StateSize>
+class replay_sampling {
+
+    public:
+    using batch_type = replay_batch<StateSize>;
+
+    template<typename Generator>
+    void sample_uniform ( batch_type & batch_, Generator & rng_ ) const noexcept {
+        assert ( derived ( ).size ( ) );
+        std::uniform_int_distribution<int> dis ( 0, derived ( ).size ( ) - 1 );
+        for ( auto & i : batch_.indices )
+            i = derived ( ).slot ( dis ( rng_ ) );
+        std::fill ( std::begin ( batch_.weights ), std::end ( batch_.weights ), 1.0f );
+        derived ( ).gather ( batch_ );
+    }
+    void sample_uniform ( batch_type & batch_ ) const noexcept { sample_uniform ( batch_, Rng::generator ( ) ); }
+
+    // beta_ anneals the importance-sampling correction, 1.0f compensates fully for the non-uniform sampling.
+    template<typename Generator>
+    void sample_prioritized ( batch_type & batch_, float beta_, Generator & rng_ ) const noexcept {
+        assert ( derived ( ).size ( ) );
+        m_priorities.sample ( batch_.indices, rng_ );
+        float const n = static_cast<float> ( derived ( ).size ( ) ), total = m_priorities.total ( );
+        float max     = 0.0f;
+        for ( int b = 0; b < batch_.size ( ); ++b )
+            max = std::max ( max, batch_.weights[ b ] = std::pow ( n * m_priorities[ batch_.indices[ b ] ] / total, -beta_ ) );
+        for ( auto & w : batch_.weights ) // normalized by the largest weight in the batch
+            w /= max;
+        derived ( ).gather ( batch_ );
+    }
+    void sample_prioritized ( batch_type & batch_, float beta_ ) const noexcept {
+        sample_prioritized ( batch_, beta_, Rng::generator ( ) );
+    }
+
+    void update_priorities ( std::span<int const> indices_, std::span<float const> td_errors_ ) noexcept {
+        assert ( indices_.size ( ) == td_errors_.size ( ) );
+        for ( std::size_t b = 0; b < indices_.size ( ); ++b )
+            m_priorities.update ( indices_[ b ], std::pow ( std::abs ( td_errors_[ b ] ) + m_epsilon, m_alpha ) );
+    }
+
+    protected:
+    replay_sampling ( int capacity_, float alpha_, float epsilon_ ) :
+        m_priorities ( capacity_ ), m_alpha ( alpha_ ), m_epsilon ( epsilon_ ) {}
+
+    // new transitions get the largest priority seen so far
+    void prioritize ( int i_ ) noexcept { m_priorities.update ( i_, m_priorities.total ( ) > 0.0f ? m_priorities.max ( ) : 1.0f ); }
+
+    // an evicted transition is never sampled (again)
+    void forget ( int i_ ) noexcept { m_priorities.update ( i_, 0.0f ); }
+
+    private:
+    [[nodiscard]] Derived const & derived ( ) const noexcept { return static_cast<Derived const &> ( *this ); }
+
+    sum_tree m_priorities;
+    float m_alpha, m_epsilon;
+};
+
+} // namespace detail
+
+// replay_buffer
+//
+//   Fixed-capacity experience replay, structure-of-arrays (every field in its own 64-byte aligned array), wrapping around
+//   like a ring_span (the oldest transitions are overwritten).
+//
+//   States are stored once, encoded (see state_encoding.hpp), in a ring of ( 1 + state_slack ) * capacity states,
+//   transitions refer to them by index. A transition of which the state equals the next state of its predecessor (the
+//   common case, within an episode) shares that state, so a transition costs ~1 state instead of 2, fp16_encoding halves
+//   that again, q8_encoding quarters it. The slack covers the first transition of every episode (2 new states), if the
+//   episodes are shorter than 1 / state_slack transitions the state ring wraps before the transition ring does, and
+//   storing a state evicts the oldest transitions that refer to its slot (size ( ) drops below capacity ( ), they are
+//   not sampled any more). Sampled batches are decoded to fp32. Sampling is either uniform or proportional to priority^alpha
+//   (Schaul et al., 2015) using a sum_tree, new transitions get the largest priority seen so far. Sampling defaults to the
+//   thread-local Rng::generator ( ).
+//
+//       buffer.sample_prioritized ( batch, beta );
+//       ... // learn, compute the td-errors of the batch
+//       buffer.update_priorities ( batch.indices, td_errors );
+//
+template<int StateSize, typename Encoding = fp32_encoding<StateSize>>
+class replay_buffer : public detail::replay_sampling<replay_buffer<StateSize, Encoding>, StateSize> {
+
+    friend class detail::replay_sampling<replay_buffer, StateSize>;
+
+    public:
+    using transition_type = transition<StateSize>;
+    using batch_type      = replay_batch<StateSize>;
+
+    struct parameters {
+        int capacity;
+        float alpha = 0.6f, epsilon = 1e-6f; // priority = ( | td-error | + epsilon ) ^ alpha
+        float state_slack = 0.25f;           // states stored beyond one per transition, per transition
+    };
+
+    explicit replay_buffer ( parameters const & parameters_ ) :
+        detail::replay_sampling<replay_buffer, StateSize> ( parameters_.capacity, parameters_.alpha, parameters_.epsilon ),
+        m_parameters ( parameters_ ), m_state_capacity ( state_capacity ( parameters_ ) ),
+        m_states ( static_cast<std::size_t> ( m_state_capacity ) * Encoding::bytes ),
+        m_state_index ( parameters_.capacity ), m_next_state_index ( parameters_.capacity ), m_actions ( parameters_.capacity ),
+        m_rewards ( parameters_.capacity ), m_dones ( parameters_.capacity ) {}
+
+    [[nodiscard]] int capacity ( ) const noexcept { return m_parameters.capacity; }
+    [[nodiscard]] int size ( ) const noexcept { return m_size; }
+    [[nodiscard]] bool empty ( ) const noexcept { return not m_size; }
+
+    void push ( transition_type const & t_ ) noexcept {
+        bool const shared = m_size and not m_last_done and t_.state == m_last_next_state;
+        if ( m_size == capacity ( ) )
+            evict_oldest ( ); // the slot of the new transition
+        int const state              = shared ? m_next_state_index[ m_last ] : store ( t_.state );
+        m_state_index[ m_next ]      = state;
+        m_next_state_index[ m_next ] = store ( t_.next_state );
+        m_last_next_state            = t_.next_state;
+        m_last_done                  = t_.done;
+        m_last                       = m_next;
+
+        m_actions[ m_next ] = t_.action;
+        m_rewards[ m_next ] = t_.reward;
+        m_dones[ m_next ]   = t_.done;
+        this->prioritize ( m_next );
+        m_next = m_next + 1 == capacity ( ) ? 0 : m_next + 1;
+        ++m_size;
+    }
+
+    void push ( std::span<transition_type const> transitions_ ) noexcept {
+        for ( auto const & t : transitions_ )
+            push ( t );
+    }
+
+    // bytes of state storage per transition (of capacity), the encoded states and the two state indices
+    [[nodiscard]] double state_bytes ( ) const noexcept {
+        return static_cast<double> ( m_states.size ( ) ) / capacity ( ) + 2 * sizeof ( int );
+    }
+
+    private:
+    [[nodiscard]] static int state_capacity ( parameters const & parameters_ ) noexcept {
+        assert ( parameters_.capacity > 0 and parameters_.state_slack >= 0.0f );
+        int const slack = static_cast<int> ( std::ceil ( parameters_.capacity * parameters_.state_slack ) );
+        return parameters_.capacity + std::max ( 2, slack );
+    }
+
+    [[nodiscard]] int oldest ( ) const noexcept { return m_next >= m_size ? m_next - m_size : m_next - m_size + capacity ( ); }
+    [[nodiscard]] int slot ( int k_ ) const noexcept {
+        int const i = oldest ( ) + k_;
+        return i < capacity ( ) ? i : i - capacity ( );
+    }
+
+    void evict_oldest ( ) noexcept {
+        this->forget ( oldest ( ) );
+        --m_size;
+    }
+
+    // the live states form one range of the ring (they are stored in order), the slot stored to is the one after the
+    // newest, so it is live only if it is the oldest live state, the transitions referring to it are evicted
+    [[nodiscard]] int store ( std::array<float, StateSize> const & state_ ) noexcept {
+        int const i = m_next_state;
+        while ( m_size and ( m_state_index[ oldest ( ) ] == i or m_next_state_index[ oldest ( ) ] == i ) )
+            evict_oldest ( );
+        Encoding::encode ( m_states.data ( ) + static_cast<std::size_t> ( i ) * Encoding::bytes, state_.data ( ) );
+        m_next_state = m_next_state + 1 == m_state_capacity ? 0 : m_next_state + 1;
+        return i;
+    }
+
+    [[nodiscard]] std::byte const * state ( int i_ ) const noexcept {
+        return m_states.data ( ) + static_cast<std::size_t> ( i_ ) * Encoding::bytes;
+    }
+
+    void gather ( batch_type & batch_ ) const noexcept {
+        float * states = batch_.states.data ( ), * next_states = batch_.next_states.data ( );
+        for ( int b = 0; b < batch_.size ( ); ++b, states += StateSize, next_states += StateSize ) {
+            int const i = batch_.indices[ b ];
+            Encoding::decode ( states, state ( m_state_index[ i ] ) );
+            Encoding::decode ( next_states, state ( m_next_state_index[ i ] ) );
+            batch_.actions[ b ] = m_actions[ i ];
+            batch_.rewards[ b ] = m_rewards[ i ];
+            batch_.dones[ b ]   = m_dones[ i ];
+        }
+    }
+
+    parameters m_parameters;
+    int m_state_capacity;
+
+    aligned_vector<std::byte> m_states; // encoded
+    aligned_vector<int> m_state_index, m_next_state_index;
+    aligned_vector<int> m_actions;
+    aligned_vector<float> m_rewards;
+    aligned_vector<std::uint8_t> m_dones;
+
+    int m_next = 0, m_size = 0, m_next_state = 0;
+
+    std::array<float, StateSize> m_last_next_state; // of the last transition pushed (at m_last), as pushed (not encoded)
+    bool m_last_done = true;
+    int m_last       = 0;
+};
+
+TD_LEARNING_END_TARGET
@@ -0,0 +1,231 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <charconv>
+#include <condition_variable>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "td_learning/aligned_allocator.hpp"
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+// series_reader
+//
+//   Streams a time series of observations (ObservationSize floats) and rewards (RewardSize floats) per time step from a
+//   file, binary (native floats, observation then reward, per step) or CSV (one step per line, observation then reward,
+//   comma separated). A background thread decodes the file into two aligned blocks of block_steps steps, while the
+//   consumer steps through the other one, so memory is constant whatever the length of the series and the reading and
+//   parsing overlap with learning. Errors of the reader thread are rethrown by next ( ).
+//
+//       series_reader<8, 1> series ( { "series.bin", series_format::binary } );
+//       for ( series_reader<8, 1>::step s; series.next ( s ); )
+//           learner.step ( s.observation, s.reward );
+//
+enum class series_format { binary, csv };
+
+template<int ObservationSize, int RewardSize = 1>
+class series_reader {
+
+    struct block {
+        aligned_vector<float> observations, rewards;
+        int steps   = 0;     // valid steps
+        bool filled = false; // by the reader thread, not yet consumed
+        bool last   = false; // the end of the series
+    };
+
+    public:
+    struct parameters {
+        std::filesystem::path path;
+        series_format format = series_format::binary;
+        int block_steps      = 4'096;
+    };
+
+    struct step {
+        std::span<float const> observation, reward; // ObservationSize, RewardSize floats
+    };
+
+    explicit series_reader ( parameters const & parameters_ ) :
+        m_parameters ( parameters_ ), m_stream ( parameters_.path, parameters_.format == series_format::binary
+                                                                       ? std::ios::binary
+                                                                       : std::ios::in ) {
+        if ( not m_stream )
+            throw std::runtime_error ( "series_reader: cannot open " + parameters_.path.string ( ) );
+        for ( auto & b : m_blocks ) {
+            b.observations.resize ( static_cast<std::size_t> ( m_parameters.block_steps ) * ObservationSize );
+            b.rewards.resize ( static_cast<std::size_t> ( m_parameters.block_steps ) * RewardSize );
+        }
+        m_reader = std::jthread ( [ this ] ( std::stop_token stop_ ) { read ( stop_ ); } );
+    }
+
+    series_reader ( series_reader const & ) = delete;
+    series_reader & operator= ( series_reader const & ) = delete;
+
+    ~series_reader ( ) {
+        {
+            std::scoped_lock lock ( m_mutex ); // not between the check of the predicate and the wait
+            m_reader.request_stop ( );
+        }
+        m_done.notify_one ( );
+    }
+
+    // the next time step, false at the end of the series (the step stays valid until the next call)
+    [[nodiscard]] bool next ( step & step_ ) {
+        if ( not m_started or m_step == m_blocks[ m_current ].steps ) { // the first block is the reader's until handed over
+            if ( m_started and m_blocks[ m_current ].last )
+                return false;
+            std::unique_lock lock ( m_mutex );
+            if ( m_started ) { // hand the consumed block back
+                m_blocks[ m_current ].filled = false;
+                m_current ^= 1;
+                m_done.notify_one ( );
+            }
+            m_started = true;
+            m_ready.wait ( lock, [ this ] { return m_blocks[ m_current ].filled or m_error; } );
+            if ( m_error )
+                std::rethrow_exception ( m_error );
+            m_step = 0;
+            if ( not m_blocks[ m_current ].steps )
+                return false;
+        }
+        block const & b = m_blocks[ m_current ];
+        step_.observation = { b.observations.data ( ) + m_step * ObservationSize, ObservationSize };
+        step_.reward      = { b.rewards.data ( ) + m_step * RewardSize, RewardSize };
+        ++m_step;
+        return true;
+    }
+
+    private:
+    void read ( std::stop_token stop_ ) {
+        try {
+            for ( int i = 0;; i ^= 1 ) {
+                {
+                    std::unique_lock lock ( m_mutex );
+                    m_done.wait ( lock, [ & ] { return stop_.stop_requested ( ) or not m_blocks[ i ].filled; } );
+                    if ( stop_.stop_requested ( ) )
+                        return;
+                }
+                block & b = m_blocks[ i ]; // owned by this thread until filled
+                b.steps   = m_parameters.format == series_format::binary ? read_binary ( b ) : read_csv ( b );
+                b.last    = b.steps < m_parameters.block_steps;
+                {
+                    std::scoped_lock lock ( m_mutex );
+                    b.filled = true;
+                }
+                m_ready.notify_one ( );
+                if ( b.last )
+                    return;
+            }
+        }
+        catch ( ... ) {
+            {
+                std::scoped_lock lock ( m_mutex );
+                m_error = std::current_exception ( );
+            }
+            m_ready.notify_one ( );
+        }
+    }
+
+    [[nodiscard]] int read_binary ( block & b_ ) {
+        constexpr int record = ObservationSize + RewardSize;
+        m_staging.resize ( static_cast<std::size_t> ( m_parameters.block_steps ) * record );
+        m_stream.read ( reinterpret_cast<char *> ( m_staging.data ( ) ),
+                        static_cast<std::streamsize> ( m_staging.size ( ) * sizeof ( float ) ) );
+        std::size_t const bytes = static_cast<std::size_t> ( m_stream.gcount ( ) );
+        if ( bytes % ( record * sizeof ( float ) ) )
+            throw std::runtime_error ( "series_reader: " + m_parameters.path.string ( ) + " ends in a partial record" );
+        int const steps = static_cast<int> ( bytes / ( record * sizeof ( float ) ) );
+        for ( int s = 0; s < steps; ++s ) { // de-interleave
+            std::memcpy ( b_.observations.data ( ) + s * ObservationSize, m_staging.data ( ) + s * record,
+                          ObservationSize * sizeof ( float ) );
+            std::memcpy ( b_.rewards.data ( ) + s * RewardSize, m_staging.data ( ) + s * record + ObservationSize,
+                          RewardSize * sizeof ( float ) );
+        }
+        return steps;
+    }
+
+    [[nodiscard]] int read_csv ( block & b_ ) {
+        int steps = 0;
+        while ( steps < m_parameters.block_steps and std::getline ( m_stream, m_text ) ) {
+            ++m_line;
+            char const *p = m_text.data ( ), *const end = p + m_text.size ( );
+            while ( p != end and ( *p == ' ' or *p == '\t' ) )
+                ++p;
+            if ( p == end or *p == '#' )
+                continue; // blank or comment
+            float * obs = b_.observations.data ( ) + steps * ObservationSize;
+            float * rew = b_.rewards.data ( ) + steps * RewardSize;
+            for ( int v = 0; v < ObservationSize + RewardSize; ++v ) {
+                while ( p != end and ( *p == ' ' or *p == ',' or *p == '\t' or *p == '\r' ) )
+                    ++p;
+                float & value              = v < ObservationSize ? obs[ v ] : rew[ v - ObservationSize ];
+                auto const [ next, error ] = std::from_chars ( p, end, value );
+                if ( error != std::errc{ } )
+                    malformed ( );
+                p = next;
+            }
+            while ( p != end and ( *p == ' ' or *p == ',' or *p == '\t' or *p == '\r' ) )
+                ++p;
+            if ( p != end ) // more values
+                malformed ( );
+            ++steps;
+        }
+        return steps;
+    }
+
+    [[noreturn]] void malformed ( ) const {
+        throw std::runtime_error ( "series_reader: " + m_parameters.path.string ( ) + ", line " + std::to_string ( m_line ) +
+                                   ", expected " + std::to_string ( ObservationSize + RewardSize ) + " numbers" );
+    }
+
+    parameters m_parameters;
+    std::ifstream m_stream;                     // reader thread
+    std::vector<float> m_staging;               // reader thread
+    std::string m_text;                         // reader thread
+    std::int64_t m_line = 0;                    // reader thread
+    block m_blocks[ 2 ];
+    int m_current = 0, m_step = 0;              // consumer
+    bool m_started = false;                     // consumer
+
+    std::exception_ptr m_error;
+    std::mutex m_mutex;
+    std::condition_variable m_ready, m_done;
+    std::jthread m_reader;
+};
+
+TD_LEARNING_END_TARGET
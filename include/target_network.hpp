@@ -0,0 +1,107 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "td_learning/detail/simd_lerp.inl"
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+// target_network
+//
+//   The target network Q' of a learner, a shadow copy of the weights of the online network, either soft (Polyak) updated
+//   every step, w' <- tau * w + ( 1 - tau ) * w', or hard copied every period steps (if tau is 0, a period of 0 or 1 copies
+//   every step).
+//
+//       target_network<network> target ( online.weights, { 0.005f } );
+//       target.update ( online.weights ); // after each gradient step
+//       online.feed_forward ( batch, target.data ( ) );
+//
+template<typename Network>
+class target_network {
+
+    public:
+    using wgt_type      = typename Network::wgt_type;
+    using const_pointer = typename Network::const_pointer;
+
+    struct parameters {
+        float tau  = 0.0f;  // soft updates if > 0
+        int period = 1'000; // steps between hard copies, if tau is 0 (0 copies every step)
+    };
+
+    target_network ( wgt_type const & weights_, parameters const & parameters_ ) noexcept :
+        m_weights ( weights_ ), m_parameters ( parameters_ ) {}
+
+    void update ( wgt_type const & weights_ ) noexcept {
+        ++m_steps;
+        if ( m_parameters.tau > 0.0f )
+            lerp_ps ( m_weights.data ( ), weights_.data ( ), m_parameters.tau, m_weights.size ( ) );
+        else if ( m_parameters.period <= 1 or m_steps % m_parameters.period == 0 )
+            sync ( weights_ );
+    }
+
+    void sync ( wgt_type const & weights_ ) noexcept { m_weights = weights_; }
+
+    [[nodiscard]] wgt_type const & weights ( ) const noexcept { return m_weights; }
+    [[nodiscard]] const_pointer data ( ) const noexcept { return m_weights.data ( ); }
+    [[nodiscard]] std::int64_t steps ( ) const noexcept { return m_steps; }
+
+    private:
+    wgt_type m_weights;
+    parameters m_parameters;
+    std::int64_t m_steps = 0;
+};
+
+// averaged_network
+//
+//   Stochastic weight averaging (Izmailov et al., 2018), the running mean of the weights added (f.e. every so many steps
+//   towards the end of training, or at the end of every cycle of a cyclic learning rate), w_swa <- w_swa + ( w - w_swa ) / n.
+//
+template<typename Network>
+class averaged_network {
+
+    public:
+    using wgt_type      = typename Network::wgt_type;
+    using const_pointer = typename Network::const_pointer;
+
+    averaged_network ( ) noexcept { m_weights.fill ( 0.0f ); }
+
+    void add ( wgt_type const & weights_ ) noexcept {
+        ++m_count;
+        lerp_ps ( m_weights.data ( ), weights_.data ( ), 1.0f / static_cast<float> ( m_count ), m_weights.size ( ) );
+    }
+
+    [[nodiscard]] wgt_type const & weights ( ) const noexcept { return m_weights; }
+    [[nodiscard]] const_pointer data ( ) const noexcept { return m_weights.data ( ); }
+    [[nodiscard]] std::int64_t count ( ) const noexcept { return m_count; }
+
+    private:
+    wgt_type m_weights;
+    std::int64_t m_count = 0;
+};
+
+TD_LEARNING_END_TARGET
@@ -0,0 +1,131 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <span>
+
+#include "td_learning/aligned_allocator.hpp"
+#include "td_learning/detail/simd_blas.inl"
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+// td_lambda
+//
+//   TD(lambda) prediction (Sutton, 1988, the td-backprop pseudo-code in td_learning.hpp) with a cascade_network, learning
+//   to predict the discounted cumulative rewards, one per output. Online: one call to step ( ) per time step, with the
+//   observation and the rewards received on arriving at it. Every output k has an eligibility trace e_k over all the
+//   weights,
+//
+//       delta_k = r_k + gamma * y_k ( t ) - y_k ( t - 1 ),    w <- w + learning_rate * sum_k delta_k * e_k,
+//       e_k <- gamma * lambda * e_k + grad_w y_k ( t ).
+//
+//   The outputs are independent predictions, a layer output activation (softmax) does not fit: its gradients are w.r.t.
+//   the net inputs, not the outputs.
+//
+//   Feed it from a series_reader to learn on a series of any length:
+//
+//       for ( series_reader<8, 1>::step s; series.next ( s ); )
+//           learner.step ( s.observation, s.reward );
+//
+template<typename Network>
+class td_lambda {
+
+    static_assert ( not Network::output_activation::is_layer,
+                    "td_lambda: the outputs are independent predictions, a layer output activation does not fit" );
+
+    public:
+    struct parameters {
+        float gamma = 0.9f, lambda = 0.8f, learning_rate = 0.01f;
+    };
+
+    td_lambda ( Network & network_, parameters const & parameters_ ) :
+        m_network ( network_ ), m_parameters ( parameters_ ),
+        m_traces ( static_cast<std::size_t> ( Network::NumOut ) * Network::NumWeights ) {
+        reset ( );
+    }
+
+    // returns the sum of the absolute td-errors (0 on the first step of an episode)
+    float step ( std::span<float const> observation_, std::span<float const> reward_ ) noexcept {
+        std::copy_n ( std::begin ( observation_ ), Network::NumRaw, std::begin ( m_network.space.raw ( ) ) );
+        m_network.feed_forward ( );
+        float error = 0.0f;
+        if ( not m_first ) {
+            auto const y = m_network.space.out ( );
+            for ( int k = 0; k < Network::NumOut; ++k )
+                error += learn ( k, reward_[ k ] + m_parameters.gamma * y[ k ] - m_previous[ k ] );
+            m_network.feed_forward ( ); // with the new weights
+        }
+        update_traces ( );
+        std::copy_n ( std::begin ( m_network.space.out ( ) ), Network::NumOut, std::begin ( m_previous ) );
+        m_first = false;
+        return error;
+    }
+
+    // the end of an episode, with the final rewards (the value of the terminal state is 0), returns as step ( )
+    float terminal ( std::span<float const> reward_ ) noexcept {
+        float error = 0.0f;
+        if ( not m_first )
+            for ( int k = 0; k < Network::NumOut; ++k )
+                error += learn ( k, reward_[ k ] - m_previous[ k ] );
+        reset ( );
+        return error;
+    }
+
+    // clears the traces, the next step starts an episode
+    void reset ( ) noexcept {
+        std::fill ( std::begin ( m_traces ), std::end ( m_traces ), 0.0f );
+        m_first = true;
+    }
+
+    private:
+    [[nodiscard]] float * trace ( int k_ ) noexcept {
+        return m_traces.data ( ) + static_cast<std::size_t> ( k_ ) * Network::NumWeights;
+    }
+
+    float learn ( int k_, float delta_ ) noexcept {
+        axpy_ps ( m_network.weights.data ( ), m_parameters.learning_rate * delta_, trace ( k_ ), Network::NumWeights );
+        return std::abs ( delta_ );
+    }
+
+    void update_traces ( ) noexcept {
+        scale_ps ( m_traces.data ( ), m_parameters.gamma * m_parameters.lambda, static_cast<int> ( m_traces.size ( ) ) );
+        for ( int k = 0; k < Network::NumOut; ++k ) // accumulate_gradient ( ) of an error of 1 is the gradient of y_k
+            m_network.accumulate_gradient ( m_network.space.data ( ), k, 1.0f, m_network.weights.data ( ), trace ( k ) );
+    }
+
+    Network & m_network;
+    parameters m_parameters;
+    aligned_vector<float> m_traces; // NumOut x NumWeights
+    std::array<float, Network::NumOut> m_previous = { };
+    bool m_first                                  = true;
+};
+
+TD_LEARNING_END_TARGET
@@ -0,0 +1,74 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+
+#include <limits>
+#include <new>
+#include <vector>
+
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+// aligned_allocator
+//
+//   Allocates on (at least) Alignment-byte boundaries, for run-time sized arrays that are handed to SIMD kernels.
+//
+template<typename T, std::size_t Alignment = 64>
+struct aligned_allocator {
+
+    static_assert ( Alignment >= alignof ( T ), "alignment too small for the value type" );
+
+    using value_type = T;
+
+    template<typename U>
+    struct rebind {
+        using other = aligned_allocator<U, Alignment>;
+    };
+
+    aligned_allocator ( ) noexcept = default;
+    template<typename U>
+    aligned_allocator ( aligned_allocator<U, Alignment> const & ) noexcept {}
+
+    [[nodiscard]] T * allocate ( std::size_t n_ ) {
+        if ( n_ > std::numeric_limits<std::size_t>::max ( ) / sizeof ( T ) )
+            throw std::bad_array_new_length ( );
+        return static_cast<T *> ( ::operator new ( n_ * sizeof ( T ), std::align_val_t{ Alignment } ) );
+    }
+
+    void deallocate ( T * p_, std::size_t ) noexcept { ::operator delete ( p_, std::align_val_t{ Alignment } ); }
+
+    template<typename U>
+    [[nodiscard]] bool operator== ( aligned_allocator<U, Alignment> const & ) const noexcept {
+        return true;
+    }
+};
+
+template<typename T, std::size_t Alignment = 64>
+using aligned_vector = std::vector<T, aligned_allocator<T, Alignment>>;
+
+TD_LEARNING_END_TARGET
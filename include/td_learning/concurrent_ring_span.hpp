@@ -0,0 +1,147 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <iterator>
+#include <thread>
+
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+// concurrent_ring_span
+//
+//   A lock-free FIFO over user supplied storage (like nonstd::ring_span, it owns nothing and never allocates), single
+//   consumer and either a single producer (MultiProducer = false) or multiple producers. The capacity (the size of the
+//   storage) must be a power of 2. Head and tail indices are free-running and live on their own cache lines, each side keeps
+//   a cached copy of the other side's index, so an uncontended push or pop touches one shared cache line.
+//
+//   Bulk push_back_n ( ) is all-or-nothing and pop_front_n ( ) takes what is available (up to n), both copy with at most two
+//   std::copy_n calls. Multiple producers reserve a range with a CAS and commit in reservation order.
+//
+template<typename T, bool MultiProducer = false>
+class concurrent_ring_span {
+
+    public:
+    using value_type = T;
+    using pointer    = T *;
+    using size_type  = std::size_t;
+
+    template<typename ContiguousIterator>
+    concurrent_ring_span ( ContiguousIterator begin_, ContiguousIterator end_ ) noexcept :
+        m_data ( std::to_address ( begin_ ) ), m_capacity ( static_cast<size_type> ( end_ - begin_ ) ), m_mask ( m_capacity - 1 ) {
+        assert ( std::has_single_bit ( m_capacity ) );
+    }
+
+    concurrent_ring_span ( concurrent_ring_span const & ) = delete;
+    concurrent_ring_span & operator= ( concurrent_ring_span const & ) = delete;
+
+    [[nodiscard]] size_type capacity ( ) const noexcept { return m_capacity; }
+
+    // approximate, exact when called from the consumer with no producer active
+    [[nodiscard]] size_type size ( ) const noexcept {
+        return m_tail.load ( std::memory_order_acquire ) - m_head.load ( std::memory_order_acquire );
+    }
+    [[nodiscard]] bool empty ( ) const noexcept { return not size ( ); }
+
+    // producer side
+
+    [[nodiscard]] bool push_back ( T const & value_ ) noexcept { return push_back_n ( &value_, 1 ); }
+
+    [[nodiscard]] bool push_back_n ( T const * values_, size_type n_ ) noexcept {
+        assert ( n_ <= m_capacity );
+        if constexpr ( MultiProducer ) {
+            size_type start = m_reserve.load ( std::memory_order_relaxed );
+            do {
+                if ( start + n_ - m_head.load ( std::memory_order_acquire ) > m_capacity )
+                    return false;
+            } while ( not m_reserve.compare_exchange_weak ( start, start + n_, std::memory_order_relaxed ) );
+            copy_in ( start, values_, n_ );
+            while ( m_tail.load ( std::memory_order_acquire ) != start ) // wait for the earlier reservations to commit
+                std::this_thread::yield ( );
+            m_tail.store ( start + n_, std::memory_order_release );
+        }
+        else {
+            size_type const tail = m_tail.load ( std::memory_order_relaxed );
+            if ( tail + n_ - m_head_cache > m_capacity ) {
+                m_head_cache = m_head.load ( std::memory_order_acquire );
+                if ( tail + n_ - m_head_cache > m_capacity )
+                    return false;
+            }
+            copy_in ( tail, values_, n_ );
+            m_tail.store ( tail + n_, std::memory_order_release );
+        }
+        return true;
+    }
+
+    // consumer side
+
+    [[nodiscard]] bool pop_front ( T & value_ ) noexcept { return pop_front_n ( &value_, 1 ); }
+
+    // returns the number of elements popped
+    size_type pop_front_n ( T * values_, size_type n_ ) noexcept {
+        size_type const head = m_head.load ( std::memory_order_relaxed );
+        if ( m_tail_cache - head < n_ )
+            m_tail_cache = m_tail.load ( std::memory_order_acquire );
+        n_ = std::min ( n_, m_tail_cache - head );
+        if ( n_ ) {
+            size_type const i = head & m_mask, first = std::min ( n_, m_capacity - i );
+            std::copy_n ( m_data + i, first, values_ );
+            std::copy_n ( m_data, n_ - first, values_ + first );
+            m_head.store ( head + n_, std::memory_order_release );
+        }
+        return n_;
+    }
+
+    private:
+    void copy_in ( size_type index_, T const * values_, size_type n_ ) noexcept {
+        size_type const i = index_ & m_mask, first = std::min ( n_, m_capacity - i );
+        std::copy_n ( values_, first, m_data + i );
+        std::copy_n ( values_ + first, n_ - first, m_data );
+    }
+
+    pointer const m_data;
+    size_type const m_capacity, m_mask;
+
+    alignas ( 64 ) std::atomic<size_type> m_head = 0; // consumer owned
+    size_type m_tail_cache                       = 0;
+
+    alignas ( 64 ) std::atomic<size_type> m_tail = 0; // (committed) producer index
+    size_type m_head_cache                       = 0; // single producer only
+
+    alignas ( 64 ) std::atomic<size_type> m_reserve = 0; // multiple producers only
+};
+
+template<typename T>
+using spsc_ring_span = concurrent_ring_span<T, false>;
+template<typename T>
+using mpsc_ring_span = concurrent_ring_span<T, true>;
+
+TD_LEARNING_END_TARGET
@@ -0,0 +1,115 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include <string>
+#include <string_view>
+
+#if defined( _MSC_VER )
+#    include <intrin.h>
+#else
+#    include <cpuid.h>
+#endif
+
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+// cpu_features
+//
+//   The SIMD extensions of the running cpu (cpuid), those of AVX and AVX-512 only if the OS saves their registers
+//   (xgetbv), and the cpu brand string. detect ( ) is cheap, but the result does not change, call it once.
+struct cpu_features {
+    bool sse41 = false, avx = false, avx2 = false, fma = false, f16c = false, bmi2 = false;
+    bool avx512f = false, avx512dq = false, avx512bw = false, avx512vl = false;
+    std::string brand;
+
+    [[nodiscard]] static cpu_features detect ( ) {
+        cpu_features f;
+        std::uint32_t r[ 4 ]; // eax, ebx, ecx, edx
+        cpuid ( 0, r );
+        std::uint32_t const max_leaf = r[ 0 ];
+        cpuid ( 1, r );
+        bool const os_saves_ymm = ( r[ 2 ] >> 27 & 1 ) and ( xcr0 ( ) & 0x06 ) == 0x06; // osxsave, xmm and ymm state
+        bool const os_saves_zmm = os_saves_ymm and ( xcr0 ( ) & 0xE0 ) == 0xE0;          // opmask and zmm state
+        f.sse41                 = r[ 2 ] >> 19 & 1;
+        f.avx                   = ( r[ 2 ] >> 28 & 1 ) and os_saves_ymm;
+        f.fma                   = ( r[ 2 ] >> 12 & 1 ) and f.avx;
+        f.f16c                  = ( r[ 2 ] >> 29 & 1 ) and f.avx;
+        if ( max_leaf >= 7 ) {
+            cpuid ( 7, r );
+            f.avx2     = ( r[ 1 ] >> 5 & 1 ) and f.avx;
+            f.bmi2     = r[ 1 ] >> 8 & 1;
+            f.avx512f  = ( r[ 1 ] >> 16 & 1 ) and os_saves_zmm;
+            f.avx512dq = ( r[ 1 ] >> 17 & 1 ) and f.avx512f;
+            f.avx512bw = ( r[ 1 ] >> 30 & 1 ) and f.avx512f;
+            f.avx512vl = ( r[ 1 ] >> 31 & 1 ) and f.avx512f;
+        }
+        cpuid ( 0x8000'0000, r );
+        if ( r[ 0 ] >= 0x8000'0004 ) {
+            char b[ 49 ] = { };
+            for ( std::uint32_t l = 0; l < 3; ++l ) {
+                cpuid ( 0x8000'0002 + l, r );
+                std::memcpy ( b + 16 * l, r, 16 );
+            }
+            std::string_view v = b;
+            while ( not v.empty ( ) and v.front ( ) == ' ' )
+                v.remove_prefix ( 1 );
+            while ( not v.empty ( ) and v.back ( ) == ' ' )
+                v.remove_suffix ( 1 );
+            f.brand = v;
+        }
+        return f;
+    }
+
+    // the minimum the library is compiled for, checked before anything else runs (see simd_dispatch.hpp)
+    [[nodiscard]] bool meets_baseline ( ) const noexcept { return sse41; }
+
+    private:
+    static void cpuid ( std::uint32_t leaf_, std::uint32_t ( &r_ )[ 4 ] ) noexcept {
+#if defined( _MSC_VER )
+        int r[ 4 ];
+        __cpuidex ( r, static_cast<int> ( leaf_ ), 0 );
+        std::memcpy ( r_, r, sizeof ( r ) );
+#else
+        __cpuid_count ( leaf_, 0, r_[ 0 ], r_[ 1 ], r_[ 2 ], r_[ 3 ] );
+#endif
+    }
+
+    [[nodiscard]] static std::uint64_t xcr0 ( ) noexcept {
+#if defined( _MSC_VER )
+        return _xgetbv ( 0 );
+#else
+        std::uint32_t lo, hi; // not _xgetbv ( ), that needs -mxsave
+        __asm__( "xgetbv" : "=a"( lo ), "=d"( hi ) : "c"( 0 ) );
+        return static_cast<std::uint64_t> ( hi ) << 32 | lo;
+#endif
+    }
+};
+
+TD_LEARNING_END_TARGET
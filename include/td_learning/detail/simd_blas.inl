@@ -0,0 +1,143 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <immintrin.h>
+
+#include <mkl.h>
+
+#include "simd_exp.inl"
+#include "../simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+// The level-1 kernels of the forward pass, the gradient, the trace updates and the optimizer steps, on the short (a few
+// hundred floats) vectors of a cascade_network. With AVX-512F they are inlined 512-bit loops, the ragged tail is one
+// masked iteration (no scalar remainder loop, no reads past the end), otherwise they are the cblas_ functions of the same
+// name.
+
+#if defined( __AVX512F__ )
+
+// sum of a_[ i ] * b_[ i ]
+[[nodiscard]] inline float dot_ps ( float const * a_, float const * b_, int n_ ) noexcept {
+    __m512 s0 = _mm512_setzero_ps ( ), s1 = _mm512_setzero_ps ( );
+    int i     = 0;
+    for ( ; i + 32 <= n_; i += 32 ) { // two chains, hides the fma latency
+        s0 = _mm512_fmadd_ps ( _mm512_loadu_ps ( a_ + i ), _mm512_loadu_ps ( b_ + i ), s0 );
+        s1 = _mm512_fmadd_ps ( _mm512_loadu_ps ( a_ + i + 16 ), _mm512_loadu_ps ( b_ + i + 16 ), s1 );
+    }
+    for ( ; i < n_; i += 16 ) {
+        __mmask16 const m = tail_mask<__m512> ( n_ - i );
+        s0                = _mm512_fmadd_ps ( _mm512_maskz_loadu_ps ( m, a_ + i ), _mm512_maskz_loadu_ps ( m, b_ + i ), s0 );
+    }
+    return _mm512_reduce_add_ps ( _mm512_add_ps ( s0, s1 ) );
+}
+
+// y_ <- y_ + a_ * x_
+inline void axpy_ps ( float * y_, float a_, float const * x_, int n_ ) noexcept {
+    __m512 const a = _mm512_set1_ps ( a_ );
+    for ( int i = 0; i < n_; i += 16 ) {
+        __mmask16 const m = tail_mask<__m512> ( n_ - i );
+        _mm512_mask_storeu_ps ( y_ + i, m,
+                                _mm512_fmadd_ps ( a, _mm512_maskz_loadu_ps ( m, x_ + i ), _mm512_maskz_loadu_ps ( m, y_ + i ) ) );
+    }
+}
+
+// x_ <- a_ * x_
+inline void scale_ps ( float * x_, float a_, int n_ ) noexcept {
+    __m512 const a = _mm512_set1_ps ( a_ );
+    for ( int i = 0; i < n_; i += 16 ) {
+        __mmask16 const m = tail_mask<__m512> ( n_ - i );
+        _mm512_mask_storeu_ps ( x_ + i, m, _mm512_mul_ps ( a, _mm512_maskz_loadu_ps ( m, x_ + i ) ) );
+    }
+}
+
+#else
+
+[[nodiscard]] inline float dot_ps ( float const * a_, float const * b_, int n_ ) noexcept {
+    return cblas_sdot ( n_, a_, 1, b_, 1 );
+}
+
+inline void axpy_ps ( float * y_, float a_, float const * x_, int n_ ) noexcept { cblas_saxpy ( n_, a_, x_, 1, y_, 1 ); }
+
+inline void scale_ps ( float * x_, float a_, int n_ ) noexcept { cblas_sscal ( n_, a_, x_, 1 ); }
+
+#endif
+
+// sum of a_[ i ] * b_[ i ], always inlined intrinsics (dot_ps may be a library call), four independent chains and a masked
+// tail (a scalar one with SSE4.1), one of the forward kernels the autotuner chooses from (see autotune.hpp)
+[[nodiscard]] inline float dot_unrolled_ps ( float const * a_, float const * b_, int n_ ) noexcept {
+#if defined( __AVX512F__ )
+    __m512 s0 = _mm512_setzero_ps ( ), s1 = _mm512_setzero_ps ( ), s2 = _mm512_setzero_ps ( ), s3 = _mm512_setzero_ps ( );
+    int i     = 0;
+    for ( ; i + 64 <= n_; i += 64 ) {
+        s0 = _mm512_fmadd_ps ( _mm512_loadu_ps ( a_ + i ), _mm512_loadu_ps ( b_ + i ), s0 );
+        s1 = _mm512_fmadd_ps ( _mm512_loadu_ps ( a_ + i + 16 ), _mm512_loadu_ps ( b_ + i + 16 ), s1 );
+        s2 = _mm512_fmadd_ps ( _mm512_loadu_ps ( a_ + i + 32 ), _mm512_loadu_ps ( b_ + i + 32 ), s2 );
+        s3 = _mm512_fmadd_ps ( _mm512_loadu_ps ( a_ + i + 48 ), _mm512_loadu_ps ( b_ + i + 48 ), s3 );
+    }
+    for ( ; i < n_; i += 16 ) {
+        __mmask16 const m = tail_mask<__m512> ( n_ - i );
+        s0                = _mm512_fmadd_ps ( _mm512_maskz_loadu_ps ( m, a_ + i ), _mm512_maskz_loadu_ps ( m, b_ + i ), s0 );
+    }
+    return _mm512_reduce_add_ps ( _mm512_add_ps ( _mm512_add_ps ( s0, s1 ), _mm512_add_ps ( s2, s3 ) ) );
+#elif defined( __AVX2__ )
+    __m256 s0 = _mm256_setzero_ps ( ), s1 = _mm256_setzero_ps ( ), s2 = _mm256_setzero_ps ( ), s3 = _mm256_setzero_ps ( );
+    int i     = 0;
+    for ( ; i + 32 <= n_; i += 32 ) {
+        s0 = _mm256_fmadd_ps ( _mm256_loadu_ps ( a_ + i ), _mm256_loadu_ps ( b_ + i ), s0 );
+        s1 = _mm256_fmadd_ps ( _mm256_loadu_ps ( a_ + i + 8 ), _mm256_loadu_ps ( b_ + i + 8 ), s1 );
+        s2 = _mm256_fmadd_ps ( _mm256_loadu_ps ( a_ + i + 16 ), _mm256_loadu_ps ( b_ + i + 16 ), s2 );
+        s3 = _mm256_fmadd_ps ( _mm256_loadu_ps ( a_ + i + 24 ), _mm256_loadu_ps ( b_ + i + 24 ), s3 );
+    }
+    for ( ; i < n_; i += 8 ) {
+        __m256i const m = _mm256_castps_si256 ( tail_mask<__m256> ( n_ - i ) );
+        s0              = _mm256_fmadd_ps ( _mm256_maskload_ps ( a_ + i, m ), _mm256_maskload_ps ( b_ + i, m ), s0 );
+    }
+    __m256 const s = _mm256_add_ps ( _mm256_add_ps ( s0, s1 ), _mm256_add_ps ( s2, s3 ) );
+    __m128 h       = _mm_add_ps ( _mm256_castps256_ps128 ( s ), _mm256_extractf128_ps ( s, 1 ) );
+    h              = _mm_add_ps ( h, _mm_movehl_ps ( h, h ) );
+    return _mm_cvtss_f32 ( _mm_add_ss ( h, _mm_movehdup_ps ( h ) ) );
+#else
+    __m128 s0 = _mm_setzero_ps ( ), s1 = _mm_setzero_ps ( ), s2 = _mm_setzero_ps ( ), s3 = _mm_setzero_ps ( );
+    int i     = 0;
+    for ( ; i + 16 <= n_; i += 16 ) {
+        s0 = _mm_add_ps ( _mm_mul_ps ( _mm_loadu_ps ( a_ + i ), _mm_loadu_ps ( b_ + i ) ), s0 );
+        s1 = _mm_add_ps ( _mm_mul_ps ( _mm_loadu_ps ( a_ + i + 4 ), _mm_loadu_ps ( b_ + i + 4 ) ), s1 );
+        s2 = _mm_add_ps ( _mm_mul_ps ( _mm_loadu_ps ( a_ + i + 8 ), _mm_loadu_ps ( b_ + i + 8 ) ), s2 );
+        s3 = _mm_add_ps ( _mm_mul_ps ( _mm_loadu_ps ( a_ + i + 12 ), _mm_loadu_ps ( b_ + i + 12 ) ), s3 );
+    }
+    for ( ; i + 4 <= n_; i += 4 )
+        s0 = _mm_add_ps ( _mm_mul_ps ( _mm_loadu_ps ( a_ + i ), _mm_loadu_ps ( b_ + i ) ), s0 );
+    __m128 h = _mm_add_ps ( _mm_add_ps ( s0, s1 ), _mm_add_ps ( s2, s3 ) );
+    h        = _mm_add_ps ( h, _mm_movehl_ps ( h, h ) );
+    float s  = _mm_cvtss_f32 ( _mm_add_ss ( h, _mm_movehdup_ps ( h ) ) );
+    for ( ; i < n_; ++i )
+        s += a_[ i ] * b_[ i ];
+    return s;
+#endif
+}
+
+TD_LEARNING_END_TARGET
@@ -1,10 +1,26 @@
 
+#pragma once
+
+#include <immintrin.h>
+
+#include "../simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+// The __m256 functions need AVX2/FMA enabled (the avx2 and avx512 targets, see simd_target.hpp), without it only the
+// __m128 functions are defined, also with MSVC (which accepts the intrinsics of any ISA anywhere), the sse41 target is SSE.
+#if defined( __AVX2__ )
+#    define TD_LEARNING_AVX2 1
+#else
+#    define TD_LEARNING_AVX2 0
+#endif
+
 // this code was lifted from SO (license).
 
 #define USE_FMA true
 
 /* max. rel. error = 1.72863156e-3 on [-87.33654, 88.72283] */
-[[nodiscard]] __m128 __mm_exp_ps ( __m128 x ) noexcept { // https://stackoverflow.com/a/47025627/646940
+[[nodiscard]] inline __m128 __mm_exp_ps ( __m128 x ) noexcept { // https://stackoverflow.com/a/47025627/646940
     __m128 t, f, e, p, r;
     __m128i i, j;
     __m128 l2e = _mm_set1_ps ( 1.442695041f ); /* log2(e) */
@@ -34,10 +50,12 @@
     return r;
 }
 
+#if TD_LEARNING_AVX2
+
 /* compute exp(x) for x in [-87.33654f, 88.72283]
    maximum relative error: 3.1575e-6 (USE_FMA = 0); 3.1533e-6 (USE_FMA = 1)
 */
-[[nodiscard]] __m256 _mm256_exp_ps ( __m256 x ) { // https://stackoverflow.com/a/49090523/646940
+[[nodiscard]] inline __m256 _mm256_exp_ps ( __m256 x ) { // https://stackoverflow.com/a/49090523/646940
     __m256 t, f, p, r;
     __m256i i, j;
 
@@ -92,13 +110,362 @@
     return r;
 }
 
-/* if higher accuracy is required, the degree of the polynomial approximation can be bumped up by one, using the following set of
-    coefficients:
-   maximum relative error: 1.7428e-7 (USE_FMA = 0); 1.6586e-7 (USE_FMA = 1)
-const __m256 c0 = _mm256_set1_ps ( 0.008301110f );
-const __m256 c1 = _mm256_set1_ps ( 0.041906696f );
-const __m256 c2 = _mm256_set1_ps ( 0.166674897f );
-const __m256 c3 = _mm256_set1_ps ( 0.499990642f );
-const __m256 c4 = _mm256_set1_ps ( 0.999999762f );
-const __m256 c5 = _mm256_set1_ps ( 1.000000000f );
+/* compute log(x) for normal x > 0 (after Cephes' logf, S. L. Moshier), max. rel. error ~ 2e-7, log(0) is a large negative
+   number (x is clamped to FLT_MIN), not -inf
 */
+[[nodiscard]] inline __m256 _mm256_log_ps ( __m256 x ) noexcept {
+    const __m256 one = _mm256_set1_ps ( 1.0f );
+    x                = _mm256_max_ps ( x, _mm256_set1_ps ( 1.17549435e-38f ) ); /* FLT_MIN */
+
+    /* x = m * 2^e, m in [0.5, 1) */
+    __m256i const bits = _mm256_castps_si256 ( x );
+    __m256 e = _mm256_cvtepi32_ps ( _mm256_sub_epi32 ( _mm256_srli_epi32 ( bits, 23 ), _mm256_set1_epi32 ( 126 ) ) );
+    __m256 m = _mm256_castsi256_ps (
+        _mm256_or_si256 ( _mm256_and_si256 ( bits, _mm256_set1_epi32 ( 0x007F'FFFF ) ), _mm256_set1_epi32 ( 0x3F00'0000 ) ) );
+
+    /* m < sqrt(1/2) ? ( e - 1, 2m - 1 ) : ( e, m - 1 ) */
+    __m256 const small = _mm256_cmp_ps ( m, _mm256_set1_ps ( 0.707106781186547524f ), _CMP_LT_OQ );
+    e                  = _mm256_sub_ps ( e, _mm256_and_ps ( one, small ) );
+    m                  = _mm256_sub_ps ( _mm256_add_ps ( m, _mm256_and_ps ( m, small ) ), one );
+
+    __m256 const z = _mm256_mul_ps ( m, m );
+    __m256 p       = _mm256_set1_ps ( 7.0376836292e-2f );
+    p              = _mm256_fmadd_ps ( p, m, _mm256_set1_ps ( -1.1514610310e-1f ) );
+    p              = _mm256_fmadd_ps ( p, m, _mm256_set1_ps ( 1.1676998740e-1f ) );
+    p              = _mm256_fmadd_ps ( p, m, _mm256_set1_ps ( -1.2420140846e-1f ) );
+    p              = _mm256_fmadd_ps ( p, m, _mm256_set1_ps ( 1.4249322787e-1f ) );
+    p              = _mm256_fmadd_ps ( p, m, _mm256_set1_ps ( -1.6668057665e-1f ) );
+    p              = _mm256_fmadd_ps ( p, m, _mm256_set1_ps ( 2.0000714765e-1f ) );
+    p              = _mm256_fmadd_ps ( p, m, _mm256_set1_ps ( -2.4999993993e-1f ) );
+    p              = _mm256_fmadd_ps ( p, m, _mm256_set1_ps ( 3.3333331174e-1f ) );
+    p              = _mm256_mul_ps ( _mm256_mul_ps ( p, m ), z );
+
+    p = _mm256_fmadd_ps ( e, _mm256_set1_ps ( -2.12194440e-4f ), p ); /* log(2)_lo * e */
+    p = _mm256_fnmadd_ps ( _mm256_set1_ps ( 0.5f ), z, p );
+    return _mm256_fmadd_ps ( e, _mm256_set1_ps ( 0.693359375f ), _mm256_add_ps ( m, p ) ); /* log(2)_hi * e */
+}
+
+#endif // TD_LEARNING_AVX2
+
+// Accuracy tiers of the exp_ps, log_ps, logistic_ps and tanh_ps family below, measured over the clamped range:
+//
+//                 exp (rel.)   log (abs.)   logistic (abs.)   tanh (abs.)
+//   fast          1.7e-3       1.3e-4       5.6e-4            1.1e-3        rcp instead of div
+//   medium        3.2e-6       3.9e-6       8.4e-7            1.6e-6        rcp and a Newton step (logistic), div (tanh)
+//   accurate      1.6e-7       6.0e-8       9.1e-8            1.1e-7        div, tanh a polynomial near 0
+//
+// Each call site picks its tier at compile time, exp_ps<simd_accuracy::fast> ( x ), or gets the default tier (medium, or
+// TD_LEARNING_SIMD_ACCURACY, f.e. -DTD_LEARNING_SIMD_ACCURACY=accurate). There are overloads for __m128 (SSE4.1, fma if
+// available), __m256 (AVX2/FMA) and __m512 (if AVX-512F is enabled). Arguments are clamped to the range with a finite
+// (normal) result, which maps NaN (f.e. uninitialized padding lanes) to the lower end of the range. The overloads taking a
+// mask return 0 in the lanes not kept, as reductions over a padded tail need, tail_mask<V> ( n ) keeps the first n lanes.
+
+enum class simd_accuracy { fast, medium, accurate };
+
+#if not defined( TD_LEARNING_SIMD_ACCURACY )
+#    define TD_LEARNING_SIMD_ACCURACY medium
+#endif
+
+inline constexpr simd_accuracy simd_accuracy_default = simd_accuracy::TD_LEARNING_SIMD_ACCURACY;
+
+namespace detail {
+
+template<typename V>
+struct simd_ops;
+
+template<>
+struct simd_ops<__m128> {
+    using mask_type = __m128;
+
+    static constexpr int width = 4;
+
+    [[nodiscard]] static __m128 loadu ( float const * p_ ) noexcept { return _mm_loadu_ps ( p_ ); }
+    static void storeu ( float * p_, __m128 x_ ) noexcept { _mm_storeu_ps ( p_, x_ ); }
+    [[nodiscard]] static __m128 set1 ( float f_ ) noexcept { return _mm_set1_ps ( f_ ); }
+    [[nodiscard]] static __m128 add ( __m128 a_, __m128 b_ ) noexcept { return _mm_add_ps ( a_, b_ ); }
+    [[nodiscard]] static __m128 sub ( __m128 a_, __m128 b_ ) noexcept { return _mm_sub_ps ( a_, b_ ); }
+    [[nodiscard]] static __m128 mul ( __m128 a_, __m128 b_ ) noexcept { return _mm_mul_ps ( a_, b_ ); }
+    [[nodiscard]] static __m128 div ( __m128 a_, __m128 b_ ) noexcept { return _mm_div_ps ( a_, b_ ); }
+    [[nodiscard]] static __m128 min ( __m128 a_, __m128 b_ ) noexcept { return _mm_min_ps ( a_, b_ ); }
+    [[nodiscard]] static __m128 max ( __m128 a_, __m128 b_ ) noexcept { return _mm_max_ps ( a_, b_ ); }
+#if defined( __FMA__ )
+    [[nodiscard]] static __m128 fmadd ( __m128 a_, __m128 b_, __m128 c_ ) noexcept { return _mm_fmadd_ps ( a_, b_, c_ ); }
+    [[nodiscard]] static __m128 fnmadd ( __m128 a_, __m128 b_, __m128 c_ ) noexcept { return _mm_fnmadd_ps ( a_, b_, c_ ); }
+#else
+    [[nodiscard]] static __m128 fmadd ( __m128 a_, __m128 b_, __m128 c_ ) noexcept { return add ( mul ( a_, b_ ), c_ ); }
+    [[nodiscard]] static __m128 fnmadd ( __m128 a_, __m128 b_, __m128 c_ ) noexcept { return sub ( c_, mul ( a_, b_ ) ); }
+#endif
+    [[nodiscard]] static __m128 rint ( __m128 x_ ) noexcept {
+        return _mm_round_ps ( x_, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC );
+    }
+    [[nodiscard]] static __m128 floor ( __m128 x_ ) noexcept { return _mm_floor_ps ( x_ ); }
+    [[nodiscard]] static __m128 rcp ( __m128 x_ ) noexcept { return _mm_rcp_ps ( x_ ); }
+    [[nodiscard]] static __m128 abs ( __m128 x_ ) noexcept { return _mm_andnot_ps ( _mm_set1_ps ( -0.0f ), x_ ); }
+    // the magnitude of m_ with the sign of s_
+    [[nodiscard]] static __m128 copysign ( __m128 m_, __m128 s_ ) noexcept {
+        return _mm_or_ps ( abs ( m_ ), _mm_and_ps ( _mm_set1_ps ( -0.0f ), s_ ) );
+    }
+    [[nodiscard]] static mask_type less ( __m128 a_, __m128 b_ ) noexcept { return _mm_cmplt_ps ( a_, b_ ); }
+    // m_ ? a_ : b_
+    [[nodiscard]] static __m128 select ( mask_type m_, __m128 a_, __m128 b_ ) noexcept { return _mm_blendv_ps ( b_, a_, m_ ); }
+    [[nodiscard]] static __m128 keep ( mask_type m_, __m128 x_ ) noexcept { return _mm_and_ps ( m_, x_ ); }
+    [[nodiscard]] static mask_type tail_mask ( int n_ ) noexcept {
+        return _mm_castsi128_ps ( _mm_cmpgt_epi32 ( _mm_set1_epi32 ( n_ ), _mm_setr_epi32 ( 0, 1, 2, 3 ) ) );
+    }
+    // p_ * 2^e_, e_ integral, the result normal
+    [[nodiscard]] static __m128 ldexp ( __m128 p_, __m128 e_ ) noexcept {
+        return _mm_castsi128_ps ( _mm_add_epi32 ( _mm_slli_epi32 ( _mm_cvtps_epi32 ( e_ ), 23 ), _mm_castps_si128 ( p_ ) ) );
+    }
+    // x_ = m * 2^e_, m in [ 0.5, 1 ), x_ normal and positive
+    [[nodiscard]] static __m128 frexp ( __m128 x_, __m128 & e_ ) noexcept {
+        __m128i const bits = _mm_castps_si128 ( x_ );
+        e_ = _mm_cvtepi32_ps ( _mm_sub_epi32 ( _mm_srli_epi32 ( bits, 23 ), _mm_set1_epi32 ( 126 ) ) );
+        return _mm_castsi128_ps (
+            _mm_or_si128 ( _mm_and_si128 ( bits, _mm_set1_epi32 ( 0x007F'FFFF ) ), _mm_set1_epi32 ( 0x3F00'0000 ) ) );
+    }
+};
+
+#if TD_LEARNING_AVX2
+
+template<>
+struct simd_ops<__m256> {
+    using mask_type = __m256;
+
+    static constexpr int width = 8;
+
+    [[nodiscard]] static __m256 loadu ( float const * p_ ) noexcept { return _mm256_loadu_ps ( p_ ); }
+    static void storeu ( float * p_, __m256 x_ ) noexcept { _mm256_storeu_ps ( p_, x_ ); }
+    [[nodiscard]] static __m256 set1 ( float f_ ) noexcept { return _mm256_set1_ps ( f_ ); }
+    [[nodiscard]] static __m256 add ( __m256 a_, __m256 b_ ) noexcept { return _mm256_add_ps ( a_, b_ ); }
+    [[nodiscard]] static __m256 sub ( __m256 a_, __m256 b_ ) noexcept { return _mm256_sub_ps ( a_, b_ ); }
+    [[nodiscard]] static __m256 mul ( __m256 a_, __m256 b_ ) noexcept { return _mm256_mul_ps ( a_, b_ ); }
+    [[nodiscard]] static __m256 div ( __m256 a_, __m256 b_ ) noexcept { return _mm256_div_ps ( a_, b_ ); }
+    [[nodiscard]] static __m256 min ( __m256 a_, __m256 b_ ) noexcept { return _mm256_min_ps ( a_, b_ ); }
+    [[nodiscard]] static __m256 max ( __m256 a_, __m256 b_ ) noexcept { return _mm256_max_ps ( a_, b_ ); }
+    [[nodiscard]] static __m256 fmadd ( __m256 a_, __m256 b_, __m256 c_ ) noexcept { return _mm256_fmadd_ps ( a_, b_, c_ ); }
+    [[nodiscard]] static __m256 fnmadd ( __m256 a_, __m256 b_, __m256 c_ ) noexcept { return _mm256_fnmadd_ps ( a_, b_, c_ ); }
+    [[nodiscard]] static __m256 rint ( __m256 x_ ) noexcept {
+        return _mm256_round_ps ( x_, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC );
+    }
+    [[nodiscard]] static __m256 floor ( __m256 x_ ) noexcept { return _mm256_floor_ps ( x_ ); }
+    [[nodiscard]] static __m256 rcp ( __m256 x_ ) noexcept { return _mm256_rcp_ps ( x_ ); }
+    [[nodiscard]] static __m256 abs ( __m256 x_ ) noexcept { return _mm256_andnot_ps ( _mm256_set1_ps ( -0.0f ), x_ ); }
+    [[nodiscard]] static __m256 copysign ( __m256 m_, __m256 s_ ) noexcept {
+        return _mm256_or_ps ( abs ( m_ ), _mm256_and_ps ( _mm256_set1_ps ( -0.0f ), s_ ) );
+    }
+    [[nodiscard]] static mask_type less ( __m256 a_, __m256 b_ ) noexcept { return _mm256_cmp_ps ( a_, b_, _CMP_LT_OQ ); }
+    [[nodiscard]] static __m256 select ( mask_type m_, __m256 a_, __m256 b_ ) noexcept { return _mm256_blendv_ps ( b_, a_, m_ ); }
+    [[nodiscard]] static __m256 keep ( mask_type m_, __m256 x_ ) noexcept { return _mm256_and_ps ( m_, x_ ); }
+    [[nodiscard]] static mask_type tail_mask ( int n_ ) noexcept {
+        return _mm256_castsi256_ps (
+            _mm256_cmpgt_epi32 ( _mm256_set1_epi32 ( n_ ), _mm256_setr_epi32 ( 0, 1, 2, 3, 4, 5, 6, 7 ) ) );
+    }
+    [[nodiscard]] static __m256 ldexp ( __m256 p_, __m256 e_ ) noexcept {
+        return _mm256_castsi256_ps (
+            _mm256_add_epi32 ( _mm256_slli_epi32 ( _mm256_cvtps_epi32 ( e_ ), 23 ), _mm256_castps_si256 ( p_ ) ) );
+    }
+    [[nodiscard]] static __m256 frexp ( __m256 x_, __m256 & e_ ) noexcept {
+        __m256i const bits = _mm256_castps_si256 ( x_ );
+        e_ = _mm256_cvtepi32_ps ( _mm256_sub_epi32 ( _mm256_srli_epi32 ( bits, 23 ), _mm256_set1_epi32 ( 126 ) ) );
+        return _mm256_castsi256_ps (
+            _mm256_or_si256 ( _mm256_and_si256 ( bits, _mm256_set1_epi32 ( 0x007F'FFFF ) ), _mm256_set1_epi32 ( 0x3F00'0000 ) ) );
+    }
+};
+
+#endif // TD_LEARNING_AVX2
+
+#if defined( __AVX512F__ )
+
+template<>
+struct simd_ops<__m512> {
+    using mask_type = __mmask16;
+
+    static constexpr int width = 16;
+
+    [[nodiscard]] static __m512 loadu ( float const * p_ ) noexcept { return _mm512_loadu_ps ( p_ ); }
+    static void storeu ( float * p_, __m512 x_ ) noexcept { _mm512_storeu_ps ( p_, x_ ); }
+    [[nodiscard]] static __m512 set1 ( float f_ ) noexcept { return _mm512_set1_ps ( f_ ); }
+    [[nodiscard]] static __m512 add ( __m512 a_, __m512 b_ ) noexcept { return _mm512_add_ps ( a_, b_ ); }
+    [[nodiscard]] static __m512 sub ( __m512 a_, __m512 b_ ) noexcept { return _mm512_sub_ps ( a_, b_ ); }
+    [[nodiscard]] static __m512 mul ( __m512 a_, __m512 b_ ) noexcept { return _mm512_mul_ps ( a_, b_ ); }
+    [[nodiscard]] static __m512 div ( __m512 a_, __m512 b_ ) noexcept { return _mm512_div_ps ( a_, b_ ); }
+    [[nodiscard]] static __m512 min ( __m512 a_, __m512 b_ ) noexcept { return _mm512_min_ps ( a_, b_ ); }
+    [[nodiscard]] static __m512 max ( __m512 a_, __m512 b_ ) noexcept { return _mm512_max_ps ( a_, b_ ); }
+    [[nodiscard]] static __m512 fmadd ( __m512 a_, __m512 b_, __m512 c_ ) noexcept { return _mm512_fmadd_ps ( a_, b_, c_ ); }
+    [[nodiscard]] static __m512 fnmadd ( __m512 a_, __m512 b_, __m512 c_ ) noexcept { return _mm512_fnmadd_ps ( a_, b_, c_ ); }
+    [[nodiscard]] static __m512 rint ( __m512 x_ ) noexcept {
+        return _mm512_roundscale_ps ( x_, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC );
+    }
+    [[nodiscard]] static __m512 floor ( __m512 x_ ) noexcept {
+        return _mm512_roundscale_ps ( x_, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC );
+    }
+    [[nodiscard]] static __m512 rcp ( __m512 x_ ) noexcept { return _mm512_rcp14_ps ( x_ ); }
+    [[nodiscard]] static __m512 abs ( __m512 x_ ) noexcept { return _mm512_abs_ps ( x_ ); }
+    [[nodiscard]] static __m512 copysign ( __m512 m_, __m512 s_ ) noexcept { // AVX-512F has no and/or_ps, sign ? s_ : m_ bitwise
+        __m512i const sign = _mm512_set1_epi32 ( static_cast<int> ( 0x8000'0000 ) );
+        return _mm512_castsi512_ps (
+            _mm512_ternarylogic_epi32 ( sign, _mm512_castps_si512 ( s_ ), _mm512_castps_si512 ( m_ ), 0xCA ) );
+    }
+    [[nodiscard]] static mask_type less ( __m512 a_, __m512 b_ ) noexcept { return _mm512_cmp_ps_mask ( a_, b_, _CMP_LT_OQ ); }
+    [[nodiscard]] static __m512 select ( mask_type m_, __m512 a_, __m512 b_ ) noexcept {
+        return _mm512_mask_blend_ps ( m_, b_, a_ );
+    }
+    [[nodiscard]] static __m512 keep ( mask_type m_, __m512 x_ ) noexcept { return _mm512_maskz_mov_ps ( m_, x_ ); }
+    [[nodiscard]] static mask_type tail_mask ( int n_ ) noexcept {
+        return n_ >= 16 ? mask_type { 0xFFFF } : static_cast<mask_type> ( ( 1u << ( n_ > 0 ? n_ : 0 ) ) - 1u );
+    }
+    [[nodiscard]] static __m512 ldexp ( __m512 p_, __m512 e_ ) noexcept { return _mm512_scalef_ps ( p_, e_ ); }
+    [[nodiscard]] static __m512 frexp ( __m512 x_, __m512 & e_ ) noexcept {
+        e_ = _mm512_add_ps ( _mm512_getexp_ps ( x_ ), _mm512_set1_ps ( 1.0f ) );
+        return _mm512_getmant_ps ( x_, _MM_MANT_NORM_p5_1, _MM_MANT_SIGN_src );
+    }
+};
+
+#endif // __AVX512F__
+
+} // namespace detail
+
+template<typename V>
+[[nodiscard]] inline typename detail::simd_ops<V>::mask_type tail_mask ( int n_ ) noexcept {
+    return detail::simd_ops<V>::tail_mask ( n_ );
+}
+
+// exp ( x_ ) for x_ in [ -87.3365448, 88.3762627 ], clamped (FLT_MIN and ~FLT_MAX at the ends)
+template<simd_accuracy Accuracy = simd_accuracy_default, typename V>
+[[nodiscard]] inline V exp_ps ( V x_ ) noexcept {
+    using o = detail::simd_ops<V>;
+    x_      = o::min ( o::max ( x_, o::set1 ( -87.3365448f ) ), o::set1 ( 88.3762627f ) ); // NaN -> the lower end
+    if constexpr ( Accuracy == simd_accuracy::fast ) {
+        // exp ( x ) = 2^i * 2^f, i = floor ( log2 ( e ) * x ), 0 <= f < 1, 2^f quadratic
+        V const t = o::mul ( x_, o::set1 ( 1.442695041f ) ), i = o::floor ( t ), f = o::sub ( t, i );
+        V p       = o::fmadd ( o::set1 ( 0.3371894346f ), f, o::set1 ( 0.657636276f ) );
+        p         = o::fmadd ( p, f, o::set1 ( 1.00172476f ) );
+        return o::ldexp ( p, i );
+    }
+    else {
+        // exp ( x ) = 2^i * e^f, i = rint ( log2 ( e ) * x ), f = x - log ( 2 ) * i, | f | <= log ( 2 ) / 2
+        V const i = o::rint ( o::mul ( x_, o::set1 ( 1.442695041f ) ) );
+        V f       = o::fmadd ( i, o::set1 ( -6.93145752e-1f ), x_ ); // log ( 2 )_hi
+        f         = o::fmadd ( i, o::set1 ( -1.42860677e-6f ), f );  // log ( 2 )_lo
+        V p;
+        if constexpr ( Accuracy == simd_accuracy::medium ) {
+            p = o::fmadd ( o::set1 ( 0.041944388f ), f, o::set1 ( 0.168006673f ) );
+            p = o::fmadd ( p, f, o::set1 ( 0.499999940f ) );
+            p = o::fmadd ( p, f, o::set1 ( 0.999956906f ) );
+            p = o::fmadd ( p, f, o::set1 ( 0.999999642f ) );
+        }
+        else {
+            p = o::fmadd ( o::set1 ( 0.008301110f ), f, o::set1 ( 0.041906696f ) );
+            p = o::fmadd ( p, f, o::set1 ( 0.166674897f ) );
+            p = o::fmadd ( p, f, o::set1 ( 0.499990642f ) );
+            p = o::fmadd ( p, f, o::set1 ( 0.999999762f ) );
+            p = o::fmadd ( p, f, o::set1 ( 1.000000000f ) );
+        }
+        return o::ldexp ( p, i );
+    }
+}
+
+// log ( x_ ) for x_ in [ FLT_MIN, FLT_MAX ], clamped (log ( 0 ) is -87.3, not -inf)
+template<simd_accuracy Accuracy = simd_accuracy_default, typename V>
+[[nodiscard]] inline V log_ps ( V x_ ) noexcept {
+    using o   = detail::simd_ops<V>;
+    V const one = o::set1 ( 1.0f );
+    x_        = o::min ( o::max ( x_, o::set1 ( 1.17549435e-38f ) ), o::set1 ( 3.40282347e+38f ) ); // NaN -> FLT_MIN
+    // x = 2^e * ( 1 + u ), u in [ sqrt ( 1/2 ) - 1, sqrt ( 2 ) - 1 )
+    V e, m                               = o::frexp ( x_, e );
+    typename o::mask_type const small    = o::less ( m, o::set1 ( 0.707106781186547524f ) );
+    e                                    = o::select ( small, o::sub ( e, one ), e );
+    V const u                            = o::sub ( o::select ( small, o::add ( m, m ), m ), one );
+    V p;
+    if constexpr ( Accuracy == simd_accuracy::fast ) { // log ( 1 + u ) = u * p ( u )
+        p = o::fmadd ( o::set1 ( -0.2281064108f ), u, o::set1 ( 0.3545640653f ) );
+        p = o::fmadd ( p, u, o::set1 ( -0.5019703550f ) );
+        p = o::fmadd ( p, u, o::set1 ( 0.9997000880f ) );
+        p = o::mul ( p, u );
+    }
+    else if constexpr ( Accuracy == simd_accuracy::medium ) {
+        p = o::fmadd ( o::set1 ( -0.1433831257f ), u, o::set1 ( 0.2207029964f ) );
+        p = o::fmadd ( p, u, o::set1 ( -0.2539783176f ) );
+        p = o::fmadd ( p, u, o::set1 ( 0.3325677780f ) );
+        p = o::fmadd ( p, u, o::set1 ( -0.4999036159f ) );
+        p = o::fmadd ( p, u, o::set1 ( 1.0000046849f ) );
+        p = o::mul ( p, u );
+    }
+    else { // Cephes' logf
+        V const z = o::mul ( u, u );
+        p         = o::fmadd ( o::set1 ( 7.0376836292e-2f ), u, o::set1 ( -1.1514610310e-1f ) );
+        p         = o::fmadd ( p, u, o::set1 ( 1.1676998740e-1f ) );
+        p         = o::fmadd ( p, u, o::set1 ( -1.2420140846e-1f ) );
+        p         = o::fmadd ( p, u, o::set1 ( 1.4249322787e-1f ) );
+        p         = o::fmadd ( p, u, o::set1 ( -1.6668057665e-1f ) );
+        p         = o::fmadd ( p, u, o::set1 ( 2.0000714765e-1f ) );
+        p         = o::fmadd ( p, u, o::set1 ( -2.4999993993e-1f ) );
+        p         = o::fmadd ( p, u, o::set1 ( 3.3333331174e-1f ) );
+        p         = o::mul ( o::mul ( p, u ), z );
+        p         = o::fnmadd ( o::set1 ( 0.5f ), z, p );
+        p         = o::add ( u, p );
+    }
+    p = o::fmadd ( e, o::set1 ( -2.12194440e-4f ), p );  // log ( 2 )_lo * e
+    return o::fmadd ( e, o::set1 ( 0.693359375f ), p ); // log ( 2 )_hi * e
+}
+
+// 1 / ( 1 + exp ( -x_ ) )
+template<simd_accuracy Accuracy = simd_accuracy_default, typename V>
+[[nodiscard]] inline V logistic_ps ( V x_ ) noexcept {
+    using o     = detail::simd_ops<V>;
+    V const one = o::set1 ( 1.0f ), d = o::add ( one, exp_ps<Accuracy> ( o::sub ( o::set1 ( 0.0f ), x_ ) ) );
+    if constexpr ( Accuracy == simd_accuracy::fast ) {
+        return o::rcp ( d );
+    }
+    else if constexpr ( Accuracy == simd_accuracy::medium ) {
+        V const r = o::rcp ( d );
+        return o::fmadd ( r, o::fnmadd ( d, r, one ), r ); // one Newton step
+    }
+    else {
+        return o::div ( one, d );
+    }
+}
+
+// tanh ( x_ ) = sign ( x_ ) ( 1 - 2 / ( exp ( 2 | x_ | ) + 1 ) ), | x_ | clamped to 9 (where it rounds to 1)
+template<simd_accuracy Accuracy = simd_accuracy_default, typename V>
+[[nodiscard]] inline V tanh_ps ( V x_ ) noexcept {
+    using o     = detail::simd_ops<V>;
+    V const one = o::set1 ( 1.0f ), two = o::set1 ( 2.0f );
+    V const a   = o::min ( o::abs ( x_ ), o::set1 ( 9.0f ) ), d = o::add ( exp_ps<Accuracy> ( o::mul ( two, a ) ), one );
+    V t;
+    if constexpr ( Accuracy == simd_accuracy::fast ) {
+        t = o::fnmadd ( two, o::rcp ( d ), one );
+    }
+    else {
+        t = o::sub ( one, o::div ( two, d ) );
+        if constexpr ( Accuracy == simd_accuracy::accurate ) { // Cephes' tanhf near 0, no cancellation
+            V const z = o::mul ( a, a );
+            V p       = o::fmadd ( o::set1 ( -5.70498872745e-3f ), z, o::set1 ( 2.06390887954e-2f ) );
+            p         = o::fmadd ( p, z, o::set1 ( -5.37397155531e-2f ) );
+            p         = o::fmadd ( p, z, o::set1 ( 1.33314422036e-1f ) );
+            p         = o::fmadd ( p, z, o::set1 ( -3.33332819422e-1f ) );
+            t         = o::select ( o::less ( a, o::set1 ( 0.625f ) ), o::fmadd ( o::mul ( p, z ), a, a ), t );
+        }
+    }
+    return o::copysign ( t, x_ );
+}
+
+// the above, 0 in the lanes not in keep_
+template<simd_accuracy Accuracy = simd_accuracy_default, typename V>
+[[nodiscard]] inline V exp_ps ( V x_, typename detail::simd_ops<V>::mask_type keep_ ) noexcept {
+    return detail::simd_ops<V>::keep ( keep_, exp_ps<Accuracy> ( x_ ) );
+}
+template<simd_accuracy Accuracy = simd_accuracy_default, typename V>
+[[nodiscard]] inline V log_ps ( V x_, typename detail::simd_ops<V>::mask_type keep_ ) noexcept {
+    return detail::simd_ops<V>::keep ( keep_, log_ps<Accuracy> ( x_ ) );
+}
+template<simd_accuracy Accuracy = simd_accuracy_default, typename V>
+[[nodiscard]] inline V logistic_ps ( V x_, typename detail::simd_ops<V>::mask_type keep_ ) noexcept {
+    return detail::simd_ops<V>::keep ( keep_, logistic_ps<Accuracy> ( x_ ) );
+}
+template<simd_accuracy Accuracy = simd_accuracy_default, typename V>
+[[nodiscard]] inline V tanh_ps ( V x_, typename detail::simd_ops<V>::mask_type keep_ ) noexcept {
+    return detail::simd_ops<V>::keep ( keep_, tanh_ps<Accuracy> ( x_ ) );
+}
+
+TD_LEARNING_END_TARGET
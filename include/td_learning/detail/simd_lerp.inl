@@ -0,0 +1,182 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <immintrin.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <span>
+
+#include "simd_exp.inl"
+#include "../simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+// Linear interpolation of weight arrays, dst_ <- dst_ + t_ * ( src_ - dst_ ) = t_ * src_ + ( 1 - t_ ) * dst_, one fma per
+// vector (a multiply and an add with SSE4.1). Polyak averaging of a target network is lerp_ps ( target, online, tau ),
+// stochastic weight averaging is lerp_ps ( average, weights, 1 / ( n + 1 ) ).
+
+// arrays larger than this are streamed, they would only evict the working set; the arrays of a lerp_ps ( ) of several (f.e.
+// those of the target networks of a population, updated in a row) are streamed if their total is
+inline constexpr std::size_t lerp_streaming_threshold = 1u << 20; // bytes
+
+// lerp_array
+//
+//   One of the arrays of a lerp_ps ( ) of several, dst <- dst + t_ * ( src - dst ) over n floats.
+//
+struct lerp_array {
+    float * dst;
+    float const * src;
+    std::size_t n;
+};
+
+namespace detail {
+
+#if defined( __AVX512F__ )
+
+// the first n_ (<= 16) floats
+inline void lerp_masked_ps ( float * dst_, float const * src_, __m512 t_, int n_ ) noexcept {
+    __mmask16 const m = tail_mask<__m512> ( n_ );
+    __m512 const d    = _mm512_maskz_loadu_ps ( m, dst_ );
+    _mm512_mask_storeu_ps ( dst_, m, _mm512_fmadd_ps ( t_, _mm512_sub_ps ( _mm512_maskz_loadu_ps ( m, src_ ), d ), d ) );
+}
+
+// dst_ is read once and written with non-temporal stores (bypassing the caches), the head up to the first 64-byte boundary
+// of dst_ and the tail are masked, not fenced
+inline void lerp_streamed_ps ( float * dst_, float const * src_, float t_, std::size_t n_ ) noexcept {
+    __m512 const t = _mm512_set1_ps ( t_ );
+    std::size_t i  = std::min<std::size_t> ( ( 64 - reinterpret_cast<std::uintptr_t> ( dst_ ) % 64 ) % 64 / sizeof ( float ), n_ );
+    if ( i )
+        lerp_masked_ps ( dst_, src_, t, static_cast<int> ( i ) );
+    for ( ; i + 16 <= n_; i += 16 ) {
+        __m512 const d = _mm512_load_ps ( dst_ + i );
+        _mm512_stream_ps ( dst_ + i, _mm512_fmadd_ps ( t, _mm512_sub_ps ( _mm512_loadu_ps ( src_ + i ), d ), d ) );
+    }
+    if ( i < n_ )
+        lerp_masked_ps ( dst_ + i, src_ + i, t, static_cast<int> ( n_ - i ) );
+}
+
+inline void lerp_cached_ps ( float * dst_, float const * src_, float t_, std::size_t n_ ) noexcept {
+    __m512 const t = _mm512_set1_ps ( t_ );
+    std::size_t i  = 0;
+    for ( ; i + 16 <= n_; i += 16 ) {
+        __m512 const d = _mm512_loadu_ps ( dst_ + i );
+        _mm512_storeu_ps ( dst_ + i, _mm512_fmadd_ps ( t, _mm512_sub_ps ( _mm512_loadu_ps ( src_ + i ), d ), d ) );
+    }
+    if ( i < n_ )
+        lerp_masked_ps ( dst_ + i, src_ + i, t, static_cast<int> ( n_ - i ) );
+}
+
+#elif defined( __AVX2__ )
+
+// dst_ is read once and written with non-temporal stores (bypassing the caches), after peeling off the head up to the first
+// 32-byte boundary of dst_, not fenced
+inline void lerp_streamed_ps ( float * dst_, float const * src_, float t_, std::size_t n_ ) noexcept {
+    std::size_t i = 0;
+    for ( ; i < n_ and reinterpret_cast<std::uintptr_t> ( dst_ + i ) % 32; ++i )
+        dst_[ i ] += t_ * ( src_[ i ] - dst_[ i ] );
+    __m256 const t = _mm256_set1_ps ( t_ );
+    for ( ; i + 8 <= n_; i += 8 ) {
+        __m256 const d = _mm256_load_ps ( dst_ + i );
+        _mm256_stream_ps ( dst_ + i, _mm256_fmadd_ps ( t, _mm256_sub_ps ( _mm256_loadu_ps ( src_ + i ), d ), d ) );
+    }
+    for ( ; i < n_; ++i )
+        dst_[ i ] += t_ * ( src_[ i ] - dst_[ i ] );
+}
+
+inline void lerp_cached_ps ( float * dst_, float const * src_, float t_, std::size_t n_ ) noexcept {
+    __m256 const t = _mm256_set1_ps ( t_ );
+    std::size_t i  = 0;
+    for ( ; i + 8 <= n_; i += 8 ) {
+        __m256 const d = _mm256_loadu_ps ( dst_ + i );
+        _mm256_storeu_ps ( dst_ + i, _mm256_fmadd_ps ( t, _mm256_sub_ps ( _mm256_loadu_ps ( src_ + i ), d ), d ) );
+    }
+    for ( ; i < n_; ++i )
+        dst_[ i ] += t_ * ( src_[ i ] - dst_[ i ] );
+}
+
+#else
+
+// as above, after peeling off the head up to the first 16-byte boundary of dst_
+inline void lerp_streamed_ps ( float * dst_, float const * src_, float t_, std::size_t n_ ) noexcept {
+    std::size_t i = 0;
+    for ( ; i < n_ and reinterpret_cast<std::uintptr_t> ( dst_ + i ) % 16; ++i )
+        dst_[ i ] += t_ * ( src_[ i ] - dst_[ i ] );
+    __m128 const t = _mm_set1_ps ( t_ );
+    for ( ; i + 4 <= n_; i += 4 ) {
+        __m128 const d = _mm_load_ps ( dst_ + i );
+        _mm_stream_ps ( dst_ + i, _mm_add_ps ( _mm_mul_ps ( t, _mm_sub_ps ( _mm_loadu_ps ( src_ + i ), d ) ), d ) );
+    }
+    for ( ; i < n_; ++i )
+        dst_[ i ] += t_ * ( src_[ i ] - dst_[ i ] );
+}
+
+inline void lerp_cached_ps ( float * dst_, float const * src_, float t_, std::size_t n_ ) noexcept {
+    __m128 const t = _mm_set1_ps ( t_ );
+    std::size_t i  = 0;
+    for ( ; i + 4 <= n_; i += 4 ) {
+        __m128 const d = _mm_loadu_ps ( dst_ + i );
+        _mm_storeu_ps ( dst_ + i, _mm_add_ps ( _mm_mul_ps ( t, _mm_sub_ps ( _mm_loadu_ps ( src_ + i ), d ) ), d ) );
+    }
+    for ( ; i < n_; ++i )
+        dst_[ i ] += t_ * ( src_[ i ] - dst_[ i ] );
+}
+
+#endif
+
+} // namespace detail
+
+// dst_ is read once and written with non-temporal stores, followed by a store fence (the streaming stores are weakly
+// ordered, make them visible before f.e. publishing the weights), lerp_ps ( ) decides by size, this always streams.
+inline void lerp_stream_ps ( float * dst_, float const * src_, float t_, std::size_t n_ ) noexcept {
+    detail::lerp_streamed_ps ( dst_, src_, t_, n_ );
+    _mm_sfence ( );
+}
+
+inline void lerp_ps ( float * dst_, float const * src_, float t_, std::size_t n_ ) noexcept {
+    if ( n_ * sizeof ( float ) >= lerp_streaming_threshold )
+        return lerp_stream_ps ( dst_, src_, t_, n_ );
+    detail::lerp_cached_ps ( dst_, src_, t_, n_ );
+}
+
+// all arrays_ in a row, streamed (one fence after the last) if their total size reaches the threshold, whatever their sizes
+inline void lerp_ps ( std::span<lerp_array const> arrays_, float t_ ) noexcept {
+    std::size_t n = 0;
+    for ( lerp_array const & a : arrays_ )
+        n += a.n;
+    if ( n * sizeof ( float ) >= lerp_streaming_threshold ) {
+        for ( lerp_array const & a : arrays_ )
+            detail::lerp_streamed_ps ( a.dst, a.src, t_, a.n );
+        _mm_sfence ( );
+    }
+    else {
+        for ( lerp_array const & a : arrays_ )
+            detail::lerp_cached_ps ( a.dst, a.src, t_, a.n );
+    }
+}
+
+TD_LEARNING_END_TARGET
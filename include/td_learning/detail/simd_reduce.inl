@@ -0,0 +1,63 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <immintrin.h>
+
+#include "../simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+[[nodiscard]] inline float _mm_hmax_ps ( __m128 x_ ) noexcept {
+    x_ = _mm_max_ps ( x_, _mm_movehl_ps ( x_, x_ ) );
+    x_ = _mm_max_ss ( x_, _mm_movehdup_ps ( x_ ) );
+    return _mm_cvtss_f32 ( x_ );
+}
+
+#if defined( __AVX2__ )
+
+[[nodiscard]] inline float _mm256_hmax_ps ( __m256 x_ ) noexcept {
+    return _mm_hmax_ps ( _mm_max_ps ( _mm256_castps256_ps128 ( x_ ), _mm256_extractf128_ps ( x_, 1 ) ) );
+}
+
+// max of n_ floats at p_, p_ 32-byte aligned, n_ a multiple of 8 (f.e. an AVX ready out array, padded with -inf)
+[[nodiscard]] inline float horizontal_max_ps ( float const * p_, int n_ ) noexcept {
+    __m256 m = _mm256_load_ps ( p_ );
+    for ( int i = 8; i < n_; i += 8 )
+        m = _mm256_max_ps ( m, _mm256_load_ps ( p_ + i ) );
+    return _mm256_hmax_ps ( m );
+}
+
+#else
+
+[[nodiscard]] inline float horizontal_max_ps ( float const * p_, int n_ ) noexcept {
+    __m128 m = _mm_load_ps ( p_ );
+    for ( int i = 4; i < n_; i += 4 )
+        m = _mm_max_ps ( m, _mm_load_ps ( p_ + i ) );
+    return _mm_hmax_ps ( m );
+}
+
+#endif
+
+TD_LEARNING_END_TARGET
@@ -0,0 +1,172 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#if defined( _WIN32 )
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+// mapped_file
+//
+//   A file mapped into memory, read-only or read-write. Opening read-write with a size_ creates the file if need be and
+//   grows it to size_ bytes, a size_ of 0 maps the file as it is.
+//
+class mapped_file {
+
+    public:
+    enum class access { read_only, read_write };
+    enum class advice { normal, random, sequential, will_need };
+
+    mapped_file ( std::filesystem::path const & path_, access access_, std::size_t size_ = 0 ) : m_access ( access_ ) {
+        map ( path_, size_ );
+    }
+
+    mapped_file ( mapped_file && other_ ) noexcept :
+        m_data ( std::exchange ( other_.m_data, nullptr ) ), m_size ( std::exchange ( other_.m_size, 0 ) ),
+        m_access ( other_.m_access ) {}
+
+    mapped_file ( mapped_file const & ) = delete;
+    mapped_file & operator= ( mapped_file const & ) = delete;
+
+    ~mapped_file ( ) noexcept { unmap ( ); }
+
+    [[nodiscard]] std::byte * data ( ) noexcept { return m_data; }
+    [[nodiscard]] std::byte const * data ( ) const noexcept { return m_data; }
+    [[nodiscard]] std::size_t size ( ) const noexcept { return m_size; }
+
+    // synchronous write-back of [ offset_, offset_ + bytes_ ) (rounded out to whole pages)
+    void flush ( std::size_t offset_, std::size_t bytes_ ) const {
+        std::size_t const first = offset_ - offset_ % page_size ( );
+#if defined( _WIN32 )
+        if ( not FlushViewOfFile ( m_data + first, offset_ + bytes_ - first ) )
+#else
+        if ( msync ( m_data + first, offset_ + bytes_ - first, MS_SYNC ) )
+#endif
+            throw std::runtime_error ( "mapped_file: flush failed" );
+    }
+    void flush ( ) const { flush ( 0, m_size ); }
+
+    void advise ( advice advice_ ) const noexcept {
+#if defined( _WIN32 )
+        if ( advice_ == advice::will_need ) {
+            WIN32_MEMORY_RANGE_ENTRY range{ m_data, m_size };
+            PrefetchVirtualMemory ( GetCurrentProcess ( ), 1, &range, 0 );
+        }
+#else
+        int const a[ ] = { MADV_NORMAL, MADV_RANDOM, MADV_SEQUENTIAL, MADV_WILLNEED };
+        madvise ( m_data, m_size, a[ static_cast<int> ( advice_ ) ] );
+#endif
+    }
+
+    [[nodiscard]] static std::size_t page_size ( ) noexcept {
+#if defined( _WIN32 )
+        SYSTEM_INFO info;
+        GetSystemInfo ( &info );
+        return info.dwAllocationGranularity;
+#else
+        return static_cast<std::size_t> ( sysconf ( _SC_PAGESIZE ) );
+#endif
+    }
+
+    private:
+#if defined( _WIN32 )
+    void map ( std::filesystem::path const & path_, std::size_t size_ ) {
+        bool const rw = m_access == access::read_write;
+        HANDLE file   = CreateFileW ( path_.c_str ( ), rw ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                    rw ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+        if ( file == INVALID_HANDLE_VALUE )
+            throw std::runtime_error ( "mapped_file: cannot open " + path_.string ( ) );
+        LARGE_INTEGER size;
+        GetFileSizeEx ( file, &size );
+        if ( rw and size_ > static_cast<std::size_t> ( size.QuadPart ) )
+            size.QuadPart = static_cast<LONGLONG> ( size_ );
+        m_size         = static_cast<std::size_t> ( size.QuadPart );
+        HANDLE mapping = m_size ? CreateFileMapping ( file, nullptr, rw ? PAGE_READWRITE : PAGE_READONLY, size.HighPart,
+                                                      size.LowPart, nullptr ) // grows the file
+                                : nullptr;
+        CloseHandle ( file );
+        if ( not mapping )
+            throw std::runtime_error ( "mapped_file: cannot map " + path_.string ( ) );
+        m_data = static_cast<std::byte *> ( MapViewOfFile ( mapping, rw ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0 ) );
+        CloseHandle ( mapping ); // the view keeps the mapping alive
+        if ( not m_data )
+            throw std::runtime_error ( "mapped_file: cannot map " + path_.string ( ) );
+    }
+
+    void unmap ( ) noexcept {
+        if ( m_data )
+            UnmapViewOfFile ( m_data );
+    }
+#else
+    void map ( std::filesystem::path const & path_, std::size_t size_ ) {
+        bool const rw = m_access == access::read_write;
+        int const fd  = open ( path_.c_str ( ), rw ? O_RDWR | O_CREAT | O_CLOEXEC : O_RDONLY | O_CLOEXEC, 0644 );
+        if ( fd < 0 )
+            throw std::runtime_error ( "mapped_file: cannot open " + path_.string ( ) );
+        struct stat s;
+        fstat ( fd, &s );
+        m_size = static_cast<std::size_t> ( s.st_size );
+        if ( rw and size_ > m_size ) {
+            if ( ftruncate ( fd, static_cast<off_t> ( size_ ) ) ) {
+                close ( fd );
+                throw std::runtime_error ( "mapped_file: cannot grow " + path_.string ( ) );
+            }
+            m_size = size_;
+        }
+        void * data = m_size ? mmap ( nullptr, m_size, rw ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0 ) : MAP_FAILED;
+        close ( fd ); // the mapping keeps the file open
+        if ( data == MAP_FAILED )
+            throw std::runtime_error ( "mapped_file: cannot map " + path_.string ( ) );
+        m_data = static_cast<std::byte *> ( data );
+    }
+
+    void unmap ( ) noexcept {
+        if ( m_data )
+            munmap ( m_data, m_size );
+    }
+#endif
+
+    std::byte * m_data = nullptr;
+    std::size_t m_size = 0;
+    access m_access;
+};
+
+TD_LEARNING_END_TARGET
@@ -0,0 +1,179 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+
+#include <algorithm>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+#if defined( _WIN32 )
+#    include <windows.h>
+#    pragma comment( lib, "onecore.lib" ) // VirtualAlloc2, MapViewOfFile3
+#else
+#    include <sys/mman.h>
+#    include <unistd.h>
+#endif
+
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+// mirrored_ring_buffer
+//
+//   A ring buffer of which the storage is mapped twice, back to back, in virtual memory (the same physical pages). Any run of
+//   up to capacity ( ) elements starting anywhere in the buffer is contiguous, so a sliding window over a stream can be
+//   handed to cblas_sdot ( ) or cascade_network::feed_forward ( input, weights ) as a plain pointer, without a copy. Writes
+//   are a single memcpy, whatever the position. The capacity is rounded up to fill whole pages (allocation granules on
+//   Windows).
+//
+template<typename T>
+class mirrored_ring_buffer {
+
+    static_assert ( std::is_trivially_copyable_v<T>, "mirrored_ring_buffer requires a trivially copyable value type" );
+
+    public:
+    using value_type = T;
+    using size_type  = std::size_t;
+
+    explicit mirrored_ring_buffer ( size_type capacity_ ) {
+        size_type const granule = granularity ( ), bytes = ( ( capacity_ * sizeof ( T ) + granule - 1 ) / granule ) * granule;
+        m_data                  = static_cast<T *> ( map ( bytes ) );
+        m_capacity              = bytes / sizeof ( T );
+        m_bytes                 = bytes;
+    }
+
+    mirrored_ring_buffer ( mirrored_ring_buffer const & ) = delete;
+    mirrored_ring_buffer & operator= ( mirrored_ring_buffer const & ) = delete;
+
+    ~mirrored_ring_buffer ( ) noexcept { unmap ( m_data, m_bytes ); }
+
+    [[nodiscard]] size_type capacity ( ) const noexcept { return m_capacity; }
+    [[nodiscard]] size_type size ( ) const noexcept { return m_size; }
+    [[nodiscard]] bool empty ( ) const noexcept { return not m_size; }
+    [[nodiscard]] bool full ( ) const noexcept { return m_size == m_capacity; }
+
+    void clear ( ) noexcept { m_size = 0; }
+
+    // overwrites the oldest elements when full
+    void push_back ( T const & value_ ) noexcept { push_back_n ( &value_, 1 ); }
+
+    void push_back_n ( T const * values_, size_type n_ ) noexcept {
+        assert ( n_ <= m_capacity );
+        std::memcpy ( m_data + m_end, values_, n_ * sizeof ( T ) ); // runs into the mirror, if need be
+        m_end  = ( m_end + n_ ) % m_capacity;
+        m_size = std::min ( m_size + n_, m_capacity );
+    }
+
+    void pop_front_n ( size_type n_ ) noexcept {
+        assert ( n_ <= m_size );
+        m_size -= n_;
+    }
+
+    // the (contiguous) last n_ elements pushed, oldest first
+    [[nodiscard]] std::span<T const> window ( size_type n_ ) const noexcept {
+        assert ( n_ <= m_size );
+        return { m_data + ( m_end + m_capacity - n_ ) % m_capacity, n_ };
+    }
+
+    // all elements, oldest first
+    [[nodiscard]] std::span<T const> elements ( ) const noexcept { return window ( m_size ); }
+
+    [[nodiscard]] T const & front ( ) const noexcept { return *window ( m_size ).data ( ); }
+    [[nodiscard]] T const & back ( ) const noexcept { return *window ( 1 ).data ( ); }
+
+    private:
+#if defined( _WIN32 )
+    [[nodiscard]] static size_type granularity ( ) noexcept {
+        SYSTEM_INFO info;
+        GetSystemInfo ( &info );
+        return info.dwAllocationGranularity;
+    }
+
+    [[nodiscard]] static void * map ( size_type bytes_ ) {
+        char * placeholder = static_cast<char *> (
+            VirtualAlloc2 ( nullptr, nullptr, 2 * bytes_, MEM_RESERVE | MEM_RESERVE_PLACEHOLDER, PAGE_NOACCESS, nullptr, 0 ) );
+        if ( not placeholder )
+            throw std::runtime_error ( "mirrored_ring_buffer: failed to reserve address space" );
+        VirtualFree ( placeholder, bytes_, MEM_RELEASE | MEM_PRESERVE_PLACEHOLDER ); // split in two
+        HANDLE section = CreateFileMapping ( INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD> ( bytes_ >> 32 ),
+                                             static_cast<DWORD> ( bytes_ ), nullptr );
+        void *lo = nullptr, *hi = nullptr;
+        if ( section ) {
+            lo = MapViewOfFile3 ( section, nullptr, placeholder, 0, bytes_, MEM_REPLACE_PLACEHOLDER, PAGE_READWRITE, nullptr, 0 );
+            hi = MapViewOfFile3 ( section, nullptr, placeholder + bytes_, 0, bytes_, MEM_REPLACE_PLACEHOLDER, PAGE_READWRITE,
+                                  nullptr, 0 );
+            CloseHandle ( section ); // the views keep the section alive
+        }
+        if ( not lo or not hi ) {
+            lo ? ( void ) UnmapViewOfFile ( lo ) : ( void ) VirtualFree ( placeholder, 0, MEM_RELEASE );
+            hi ? ( void ) UnmapViewOfFile ( hi ) : ( void ) VirtualFree ( placeholder + bytes_, 0, MEM_RELEASE );
+            throw std::runtime_error ( "mirrored_ring_buffer: failed to map the buffer twice" );
+        }
+        return placeholder;
+    }
+
+    static void unmap ( void * data_, size_type bytes_ ) noexcept {
+        UnmapViewOfFile ( data_ );
+        UnmapViewOfFile ( static_cast<char *> ( data_ ) + bytes_ );
+    }
+#else
+    [[nodiscard]] static size_type granularity ( ) noexcept { return static_cast<size_type> ( sysconf ( _SC_PAGESIZE ) ); }
+
+    [[nodiscard]] static void * map ( size_type bytes_ ) {
+        int const fd = memfd_create ( "mirrored_ring_buffer", MFD_CLOEXEC );
+        if ( fd < 0 )
+            throw std::runtime_error ( "mirrored_ring_buffer: memfd_create failed" );
+        if ( ftruncate ( fd, static_cast<off_t> ( bytes_ ) ) ) {
+            close ( fd );
+            throw std::runtime_error ( "mirrored_ring_buffer: ftruncate failed" );
+        }
+        // reserve twice the size, then map the same file over both halves
+        char * base = static_cast<char *> ( mmap ( nullptr, 2 * bytes_, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 ) );
+        bool const mapped =
+            base != MAP_FAILED and
+            mmap ( base, bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0 ) != MAP_FAILED and
+            mmap ( base + bytes_, bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0 ) != MAP_FAILED;
+        close ( fd ); // the mappings keep the file alive
+        if ( not mapped ) {
+            if ( base != MAP_FAILED )
+                munmap ( base, 2 * bytes_ );
+            throw std::runtime_error ( "mirrored_ring_buffer: failed to map the buffer twice" );
+        }
+        return base;
+    }
+
+    static void unmap ( void * data_, size_type bytes_ ) noexcept { munmap ( data_, 2 * bytes_ ); }
+#endif
+
+    T * m_data           = nullptr;
+    size_type m_capacity = 0, m_bytes = 0;
+    size_type m_end = 0, m_size = 0; // one past the last element, number of elements
+};
+
+TD_LEARNING_END_TARGET
@@ -0,0 +1,78 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+
+#include <memory>
+#include <new>
+
+#include "td_learning/thread_id.hpp"
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+// per_thread
+//
+//   One T per ThreadID, in a flat array (on the heap, ThreadID::max_threads of them), each on its own cache line(s), f.e.
+//   gradient buffers, scratch space or counters of the workers of a task_pool. local ( ) is the T of the calling thread, no
+//   hashing, no locking. A T is not reset when its id is reused by a new thread. Iterate over all of them (for a reduction)
+//   when the threads are quiescent.
+//
+template<typename T>
+class per_thread {
+
+    struct alignas ( 64 ) padded {
+        T value;
+    };
+
+    public:
+    using value_type = T;
+
+    per_thread ( ) : m_values ( std::make_unique<padded[]> ( size ( ) ) ) {}
+    explicit per_thread ( T const & value_ ) : per_thread ( ) {
+        for_each ( [ & ] ( T & v_ ) { v_ = value_; } );
+    }
+
+    per_thread ( per_thread const & ) = delete;
+    per_thread & operator= ( per_thread const & ) = delete;
+
+    [[nodiscard]] T & local ( ) noexcept { return m_values[ ThreadID::get ( ) ].value; }
+
+    [[nodiscard]] T & operator[] ( int id_ ) noexcept { return m_values[ id_ ].value; }
+    [[nodiscard]] T const & operator[] ( int id_ ) const noexcept { return m_values[ id_ ].value; }
+
+    [[nodiscard]] static constexpr int size ( ) noexcept { return ThreadID::max_threads; }
+
+    template<typename Function>
+    void for_each ( Function && function_ ) {
+        for ( int i = 0; i < size ( ); ++i )
+            function_ ( m_values[ i ].value );
+    }
+
+    private:
+    std::unique_ptr<padded[]> m_values;
+};
+
+TD_LEARNING_END_TARGET
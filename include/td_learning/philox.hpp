@@ -0,0 +1,234 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <immintrin.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <limits>
+
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+// philox_stream
+//
+//   Philox4x32-10 (Salmon et al., 2011, "Parallel random numbers: as easy as 1, 2, 3"), a counter-based generator, the n-th
+//   block of 4 random 32-bit words is a bijection of the 128-bit counter n under a 64-bit key, so any element of any stream
+//   can be computed without state and without regard to which thread gets to compute it. The key is the run seed, the
+//   counter is ( block, step, episode, stream ), f.e. stream = the index of an actor, episode = the episode number of that
+//   actor. The stream is a uniform random bit generator (operator ( ) returns the words of one block after the other),
+//   uniforms ( ) and bits ( ) compute 8 blocks at a time with AVX2, two times 4 with SSE4.1 (32 floats in [ 0, 1 ), or 32
+//   words, per call, the same on either).
+//   Both advance the block counter, the words left over in the scalar buffer are dropped by the batch calls.
+//
+class philox_stream {
+
+    static constexpr std::uint32_t M0 = 0xD251'1F53, M1 = 0xCD9E'8D57; // multipliers
+    static constexpr std::uint32_t W0 = 0x9E37'79B9, W1 = 0xBB67'AE85; // Weyl sequence key increments
+
+    public:
+    using result_type  = std::uint32_t;
+    using counter_type = std::array<std::uint32_t, 4>;
+    using key_type     = std::array<std::uint32_t, 2>;
+
+    static constexpr int rounds = 10, batch_size = 32;
+
+    constexpr philox_stream ( std::uint64_t seed_, std::uint32_t stream_, std::uint32_t episode_,
+                              std::uint32_t step_ = 0 ) noexcept :
+        m_key{ static_cast<std::uint32_t> ( seed_ ), static_cast<std::uint32_t> ( seed_ >> 32 ) },
+        m_counter{ 0, step_, episode_, stream_ } {}
+
+    [[nodiscard]] static constexpr result_type min ( ) noexcept { return std::numeric_limits<result_type>::min ( ); }
+    [[nodiscard]] static constexpr result_type max ( ) noexcept { return std::numeric_limits<result_type>::max ( ); }
+
+    [[nodiscard]] constexpr result_type operator( ) ( ) noexcept {
+        if ( m_i == 4 ) {
+            m_block = block ( m_counter, m_key );
+            ++m_counter[ 0 ];
+            m_i = 0;
+        }
+        return m_block[ m_i++ ];
+    }
+
+    // restarts the stream at block 0 of step_
+    constexpr void seek ( std::uint32_t step_ ) noexcept {
+        m_counter[ 0 ] = 0;
+        m_counter[ 1 ] = step_;
+        m_i            = 4;
+    }
+
+#if defined( __AVX2__ )
+
+    // 32 words, blocks [ block, block + 8 ), in block order
+    void bits ( std::uint32_t * out_ ) noexcept {
+        __m256i x[ 4 ];
+        blocks ( x );
+        // transpose, lane b of x[ w ] is word w of block b
+        __m256i const t0 = _mm256_unpacklo_epi32 ( x[ 0 ], x[ 1 ] ), t1 = _mm256_unpackhi_epi32 ( x[ 0 ], x[ 1 ] );
+        __m256i const t2 = _mm256_unpacklo_epi32 ( x[ 2 ], x[ 3 ] ), t3 = _mm256_unpackhi_epi32 ( x[ 2 ], x[ 3 ] );
+        __m256i const u0 = _mm256_unpacklo_epi64 ( t0, t2 ), u1 = _mm256_unpackhi_epi64 ( t0, t2 );
+        __m256i const u2 = _mm256_unpacklo_epi64 ( t1, t3 ), u3 = _mm256_unpackhi_epi64 ( t1, t3 );
+        auto out = reinterpret_cast<__m256i *> ( out_ );
+        _mm256_storeu_si256 ( out + 0, _mm256_permute2x128_si256 ( u0, u1, 0x20 ) ); // blocks 0, 1
+        _mm256_storeu_si256 ( out + 1, _mm256_permute2x128_si256 ( u2, u3, 0x20 ) ); // blocks 2, 3
+        _mm256_storeu_si256 ( out + 2, _mm256_permute2x128_si256 ( u0, u1, 0x31 ) ); // blocks 4, 5
+        _mm256_storeu_si256 ( out + 3, _mm256_permute2x128_si256 ( u2, u3, 0x31 ) ); // blocks 6, 7
+    }
+
+    // 32 floats in [ 0, 1 ) (24 bits each), in no particular order
+    void uniforms ( float * out_ ) noexcept {
+        __m256i x[ 4 ];
+        blocks ( x );
+        __m256 const scale = _mm256_set1_ps ( 0x1.0p-24f );
+        for ( int w = 0; w < 4; ++w )
+            _mm256_storeu_ps ( out_ + 8 * w, _mm256_mul_ps ( _mm256_cvtepi32_ps ( _mm256_srli_epi32 ( x[ w ], 8 ) ), scale ) );
+    }
+
+#else
+
+    // 32 words, blocks [ block, block + 8 ), in block order
+    void bits ( std::uint32_t * out_ ) noexcept {
+        auto out = reinterpret_cast<__m128i *> ( out_ );
+        for ( int h = 0; h < 2; ++h ) {
+            __m128i x[ 4 ];
+            blocks ( x, 4 * h );
+            // transpose, lane b of x[ w ] is word w of block b
+            __m128i const t0 = _mm_unpacklo_epi32 ( x[ 0 ], x[ 1 ] ), t1 = _mm_unpackhi_epi32 ( x[ 0 ], x[ 1 ] );
+            __m128i const t2 = _mm_unpacklo_epi32 ( x[ 2 ], x[ 3 ] ), t3 = _mm_unpackhi_epi32 ( x[ 2 ], x[ 3 ] );
+            _mm_storeu_si128 ( out + 4 * h + 0, _mm_unpacklo_epi64 ( t0, t2 ) );
+            _mm_storeu_si128 ( out + 4 * h + 1, _mm_unpackhi_epi64 ( t0, t2 ) );
+            _mm_storeu_si128 ( out + 4 * h + 2, _mm_unpacklo_epi64 ( t1, t3 ) );
+            _mm_storeu_si128 ( out + 4 * h + 3, _mm_unpackhi_epi64 ( t1, t3 ) );
+        }
+        m_counter[ 0 ] += 8;
+        m_i = 4;
+    }
+
+    // 32 floats in [ 0, 1 ) (24 bits each), in no particular order
+    void uniforms ( float * out_ ) noexcept {
+        __m128 const scale = _mm_set1_ps ( 0x1.0p-24f );
+        for ( int h = 0; h < 2; ++h ) {
+            __m128i x[ 4 ];
+            blocks ( x, 4 * h );
+            for ( int w = 0; w < 4; ++w )
+                _mm_storeu_ps ( out_ + 8 * w + 4 * h, _mm_mul_ps ( _mm_cvtepi32_ps ( _mm_srli_epi32 ( x[ w ], 8 ) ), scale ) );
+        }
+        m_counter[ 0 ] += 8;
+        m_i = 4;
+    }
+
+#endif
+
+    [[nodiscard]] static constexpr counter_type block ( counter_type c_, key_type k_ ) noexcept {
+        for ( int r = 0; r < rounds; ++r ) {
+            std::uint64_t const p0 = static_cast<std::uint64_t> ( M0 ) * c_[ 0 ];
+            std::uint64_t const p1 = static_cast<std::uint64_t> ( M1 ) * c_[ 2 ];
+            c_ = { static_cast<std::uint32_t> ( p1 >> 32 ) ^ c_[ 1 ] ^ k_[ 0 ], static_cast<std::uint32_t> ( p1 ),
+                   static_cast<std::uint32_t> ( p0 >> 32 ) ^ c_[ 3 ] ^ k_[ 1 ], static_cast<std::uint32_t> ( p0 ) };
+            k_[ 0 ] += W0;
+            k_[ 1 ] += W1;
+        }
+        return c_;
+    }
+
+    private:
+#if defined( __AVX2__ )
+
+    // the high and low halves of the 8 products a_ * m_
+    static void mulhilo ( __m256i a_, __m256i m_, __m256i & hi_, __m256i & lo_ ) noexcept {
+        __m256i const even = _mm256_mul_epu32 ( a_, m_ ), odd = _mm256_mul_epu32 ( _mm256_srli_epi64 ( a_, 32 ), m_ );
+        lo_ = _mm256_blend_epi32 ( even, _mm256_slli_epi64 ( odd, 32 ), 0b1010'1010 );
+        hi_ = _mm256_blend_epi32 ( _mm256_srli_epi64 ( even, 32 ), odd, 0b1010'1010 );
+    }
+
+    // 8 blocks (structure of arrays, x_[ w ] holds word w of the blocks), advances the block counter by 8
+    void blocks ( __m256i * x_ ) noexcept {
+        __m256i c0 = _mm256_add_epi32 ( _mm256_set1_epi32 ( static_cast<int> ( m_counter[ 0 ] ) ),
+                                        _mm256_setr_epi32 ( 0, 1, 2, 3, 4, 5, 6, 7 ) );
+        __m256i c1 = _mm256_set1_epi32 ( static_cast<int> ( m_counter[ 1 ] ) );
+        __m256i c2 = _mm256_set1_epi32 ( static_cast<int> ( m_counter[ 2 ] ) );
+        __m256i c3 = _mm256_set1_epi32 ( static_cast<int> ( m_counter[ 3 ] ) );
+        __m256i const m0 = _mm256_set1_epi32 ( static_cast<int> ( M0 ) ), m1 = _mm256_set1_epi32 ( static_cast<int> ( M1 ) );
+        key_type k       = m_key;
+        for ( int r = 0; r < rounds; ++r ) {
+            __m256i hi0, lo0, hi1, lo1;
+            mulhilo ( c0, m0, hi0, lo0 );
+            mulhilo ( c2, m1, hi1, lo1 );
+            c0 = _mm256_xor_si256 ( _mm256_xor_si256 ( hi1, c1 ), _mm256_set1_epi32 ( static_cast<int> ( k[ 0 ] ) ) );
+            c1 = lo1;
+            c2 = _mm256_xor_si256 ( _mm256_xor_si256 ( hi0, c3 ), _mm256_set1_epi32 ( static_cast<int> ( k[ 1 ] ) ) );
+            c3 = lo0;
+            k[ 0 ] += W0;
+            k[ 1 ] += W1;
+        }
+        x_[ 0 ] = c0, x_[ 1 ] = c1, x_[ 2 ] = c2, x_[ 3 ] = c3;
+        m_counter[ 0 ] += 8;
+        m_i = 4;
+    }
+
+#else
+
+    // the high and low halves of the 4 products a_ * m_
+    static void mulhilo ( __m128i a_, __m128i m_, __m128i & hi_, __m128i & lo_ ) noexcept {
+        __m128i const even = _mm_mul_epu32 ( a_, m_ ), odd = _mm_mul_epu32 ( _mm_srli_epi64 ( a_, 32 ), m_ );
+        lo_ = _mm_blend_epi16 ( even, _mm_slli_epi64 ( odd, 32 ), 0b1100'1100 );
+        hi_ = _mm_blend_epi16 ( _mm_srli_epi64 ( even, 32 ), odd, 0b1100'1100 );
+    }
+
+    // 4 blocks at the block counter + first_ (structure of arrays, x_[ w ] holds word w of the blocks)
+    void blocks ( __m128i * x_, std::uint32_t first_ ) const noexcept {
+        __m128i c0 = _mm_add_epi32 ( _mm_set1_epi32 ( static_cast<int> ( m_counter[ 0 ] + first_ ) ),
+                                     _mm_setr_epi32 ( 0, 1, 2, 3 ) );
+        __m128i c1 = _mm_set1_epi32 ( static_cast<int> ( m_counter[ 1 ] ) );
+        __m128i c2 = _mm_set1_epi32 ( static_cast<int> ( m_counter[ 2 ] ) );
+        __m128i c3 = _mm_set1_epi32 ( static_cast<int> ( m_counter[ 3 ] ) );
+        __m128i const m0 = _mm_set1_epi32 ( static_cast<int> ( M0 ) ), m1 = _mm_set1_epi32 ( static_cast<int> ( M1 ) );
+        key_type k       = m_key;
+        for ( int r = 0; r < rounds; ++r ) {
+            __m128i hi0, lo0, hi1, lo1;
+            mulhilo ( c0, m0, hi0, lo0 );
+            mulhilo ( c2, m1, hi1, lo1 );
+            c0 = _mm_xor_si128 ( _mm_xor_si128 ( hi1, c1 ), _mm_set1_epi32 ( static_cast<int> ( k[ 0 ] ) ) );
+            c1 = lo1;
+            c2 = _mm_xor_si128 ( _mm_xor_si128 ( hi0, c3 ), _mm_set1_epi32 ( static_cast<int> ( k[ 1 ] ) ) );
+            c3 = lo0;
+            k[ 0 ] += W0;
+            k[ 1 ] += W1;
+        }
+        x_[ 0 ] = c0, x_[ 1 ] = c1, x_[ 2 ] = c2, x_[ 3 ] = c3;
+    }
+
+#endif
+
+    key_type m_key;
+    counter_type m_counter;
+    counter_type m_block = { };
+    int m_i              = 4;
+};
+
+TD_LEARNING_END_TARGET
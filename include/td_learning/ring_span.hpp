@@ -239,10 +239,15 @@ nsrs_DISABLE_MSVC_WARNINGS( 4345 26439 26440 26472 26473 26481 26490 )
 
 // includes:
 
+#include <algorithm>
 #include <cassert>
 #include <iterator>
 #include <utility>
 
+#if nsrs_CPP20_OR_GREATER
+# include <span>
+#endif
+
 // additional includes:
 
 #if ! nsrs_CPP11_OR_GREATER
@@ -676,6 +681,72 @@ public:
         front_() = T( std::forward<Args>(args)...);
     }
 #endif
+#endif // nsrs_RING_SPAN_LITE_EXTENSION
+
+#if nsrs_RING_SPAN_LITE_EXTENSION
+
+    // bulk element insertion, extraction (at most two contiguous copies each, these bypass the Popper):
+
+    // like n times push_back(), overwrites the oldest elements when full
+    void push_back_n( T const * values, size_type n )
+    {
+        if ( n > m_capacity )
+        {
+            values += n - m_capacity;
+            n       = m_capacity;
+        }
+
+        size_type const overflow = m_size + n > m_capacity ? m_size + n - m_capacity : 0;
+        size_type const back_idx = normalize_( m_front_idx + m_size ); // one past back
+        size_type const first    = (std::min)( n, m_capacity - back_idx );
+
+        std::copy_n( values, first, m_data + back_idx );
+        std::copy_n( values + first, n - first, m_data );
+
+        m_front_idx = normalize_( m_front_idx + overflow );
+        m_size     += n - overflow;
+    }
+
+    // copies the n front elements to values and removes them
+    void pop_front_n( T * values, size_type n )
+    {
+        assert( n <= size() );
+
+        size_type const first = (std::min)( n, m_capacity - m_front_idx );
+
+        std::copy_n( m_data + m_front_idx, first, values );
+        std::copy_n( m_data, n - first, values + first );
+
+        pop_front_n( n );
+    }
+
+    // removes the n front elements
+    void pop_front_n( size_type n ) nsrs_noexcept
+    {
+        assert( n <= size() );
+
+        m_front_idx = normalize_( m_front_idx + n );
+        m_size     -= n;
+    }
+
+#if nsrs_CPP20_OR_GREATER
+
+    // the content, front to back, as (up to) two contiguous segments (the second one is empty if the content does not wrap):
+
+    std::pair< std::span<T>, std::span<T> > segments() nsrs_noexcept
+    {
+        size_type const first = (std::min)( m_size, m_capacity - m_front_idx );
+
+        return { std::span<T>( m_data + m_front_idx, first ), std::span<T>( m_data, m_size - first ) };
+    }
+
+    std::pair< std::span<T const>, std::span<T const> > segments() const nsrs_noexcept
+    {
+        size_type const first = (std::min)( m_size, m_capacity - m_front_idx );
+
+        return { std::span<T const>( m_data + m_front_idx, first ), std::span<T const>( m_data, m_size - first ) };
+    }
+#endif
 #endif // nsrs_RING_SPAN_LITE_EXTENSION
 
     // swap:
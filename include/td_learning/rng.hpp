@@ -0,0 +1,77 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <sax/prng_sfc.hpp>
+#include <sax/uniform_int_distribution.hpp>
+
+#include <cstdint>
+
+#include "td_learning/philox.hpp"
+#include "td_learning/thread_id.hpp"
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+#if defined( NDEBUG )
+#    define RANDOM 1
+#else
+#    define RANDOM 0
+#endif
+
+namespace Rng {
+// Chris Doty-Humphrey's Small Fast Chaotic Prng.
+[[nodiscard]] inline sax::Rng & generator ( ) noexcept {
+    if constexpr ( RANDOM ) {
+        static thread_local sax::Rng generator ( sax::os_seed ( ), sax::os_seed ( ), sax::os_seed ( ), sax::os_seed ( ) );
+        return generator;
+    }
+    else {
+        static thread_local sax::Rng generator ( sax::fixed_seed ( ) + ThreadID::get ( ) );
+        return generator;
+    }
+}
+
+// The key of the counter-based streams, the same in all threads (set it before starting any).
+[[nodiscard]] inline std::uint64_t & run_seed ( ) noexcept {
+    if constexpr ( RANDOM ) {
+        static std::uint64_t seed = static_cast<std::uint64_t> ( sax::os_seed ( ) );
+        return seed;
+    }
+    else {
+        static std::uint64_t seed = static_cast<std::uint64_t> ( sax::fixed_seed ( ) );
+        return seed;
+    }
+}
+
+// Reproducible randomness, independent of the thread and of the scheduling, f.e. stream ( actor, episode ).
+[[nodiscard]] inline philox_stream stream ( std::uint32_t stream_, std::uint32_t episode_, std::uint32_t step_ = 0 ) noexcept {
+    return { run_seed ( ), stream_, episode_, step_ };
+}
+
+} // namespace Rng
+
+#undef RANDOM
+
+TD_LEARNING_END_TARGET
@@ -0,0 +1,81 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+
+#include <array>
+#include <string_view>
+
+#include "cpu_features.hpp"
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+// simd_dispatch
+//
+//   The program is compiled once per target, sse41, avx2 (+fma, f16c) and avx-512 (f, dq, bw, vl), from one source in
+//   translation units of their own, each with its ISA flags (src/program.inl, src/program_<target>.cpp, see
+//   td_learning.vcxproj), every one in the inline namespace of its target (see simd_target.hpp). So the networks, the
+//   activation policies and their gradients, the learners and the kernels are all compiled for the target, the 512-bit
+//   code included. main ( ) (main.cpp, compiled without ISA flags) calls dispatch ( ) once, to pick the entry point of the
+//   best target of the running cpu, the environment variable TD_LEARNING_SIMD (sse41 or avx2) caps it, f.e. to compare
+//   the targets on one machine.
+//
+//   SSE4.1 is the minimum of the fleet, main.cpp checks it before any static initializer of the program runs, instead of
+//   faulting on the first SSE4.1 instruction somewhere.
+
+enum class simd_target { sse41, avx2, avx512 };
+
+inline constexpr std::array<std::string_view, 3> simd_target_names = { "sse41", "avx2", "avx512" };
+
+// the best target of the features_ (capped by TD_LEARNING_SIMD, if set), features_ meet the baseline
+[[nodiscard]] inline simd_target best_simd_target ( cpu_features const & features_ ) noexcept {
+    simd_target t = simd_target::sse41;
+    if ( features_.avx2 and features_.fma and features_.f16c ) {
+        t = simd_target::avx2;
+        if ( features_.avx512f and features_.avx512dq and features_.avx512bw and features_.avx512vl )
+            t = simd_target::avx512;
+    }
+    if ( char const * const cap = std::getenv ( "TD_LEARNING_SIMD" ); cap ) {
+        for ( std::size_t c = 0; c < simd_target_names.size ( ); ++c )
+            if ( simd_target_names[ c ] == cap and static_cast<simd_target> ( c ) < t )
+                t = static_cast<simd_target> ( c );
+    }
+    return t;
+}
+
+// the one of the functions of the targets for the running cpu, f.e. dispatch ( sse41::run, avx2::run, avx512::run )
+template<typename Function>
+[[nodiscard]] Function * dispatch ( Function * sse41_, Function * avx2_, Function * avx512_ ) {
+    switch ( best_simd_target ( cpu_features::detect ( ) ) ) {
+        case simd_target::avx512: return avx512_;
+        case simd_target::avx2: return avx2_;
+        default: return sse41_;
+    }
+}
+
+TD_LEARNING_END_TARGET
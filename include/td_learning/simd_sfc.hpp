@@ -0,0 +1,264 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <immintrin.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "td_learning/detail/simd_exp.inl"
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+// simd_sfc32
+//
+//   Chris Doty-Humphrey's Small Fast Chaotic Prng (32-bit variant, the same family as the sfc64 sax::Rng wraps), run in the
+//   8 lanes of an AVX2 register, every lane an independent generator (seeded by splitmix64 of the seed and the lane).
+//   Produces vectors of 8 uniform floats, normals (Box-Muller) and Gumbel samples, or fills arrays with them at a rate
+//   bound by memory, f.e. the initial weights of a population of networks, or exploration noise. With SSE4.1 the vectors
+//   (vector_type) are of 4 floats, the lanes [ 0, 4 ) and [ 4, 8 ) in turn, the fills draw the same streams.
+//
+class simd_sfc32 {
+
+    public:
+#if defined( __AVX2__ )
+    using vector_type = __m256;
+#else
+    using vector_type = __m128;
+#endif
+
+    static constexpr int width = sizeof ( vector_type ) / sizeof ( float );
+
+    explicit simd_sfc32 ( std::uint64_t seed_ ) noexcept {
+        alignas ( 32 ) std::uint32_t a[ 8 ], b[ 8 ], c[ 8 ];
+        for ( int l = 0; l < 8; ++l ) {
+            std::uint64_t const s = splitmix64 ( seed_ + static_cast<std::uint64_t> ( l ) * 0x9E37'79B9'7F4A'7C15 );
+            a[ l ] = 0, b[ l ] = static_cast<std::uint32_t> ( s ), c[ l ] = static_cast<std::uint32_t> ( s >> 32 );
+        }
+#if defined( __AVX2__ )
+        m_a       = _mm256_load_si256 ( reinterpret_cast<__m256i const *> ( a ) );
+        m_b       = _mm256_load_si256 ( reinterpret_cast<__m256i const *> ( b ) );
+        m_c       = _mm256_load_si256 ( reinterpret_cast<__m256i const *> ( c ) );
+        m_counter = _mm256_set1_epi32 ( 1 );
+#else
+        for ( int h = 0; h < 2; ++h ) {
+            m_a[ h ]       = _mm_load_si128 ( reinterpret_cast<__m128i const *> ( a + 4 * h ) );
+            m_b[ h ]       = _mm_load_si128 ( reinterpret_cast<__m128i const *> ( b + 4 * h ) );
+            m_c[ h ]       = _mm_load_si128 ( reinterpret_cast<__m128i const *> ( c + 4 * h ) );
+            m_counter[ h ] = _mm_set1_epi32 ( 1 );
+        }
+#endif
+        for ( int i = 0; i < 12 * 8 / width; ++i )
+            ( void ) next ( );
+    }
+
+#if defined( __AVX2__ )
+
+    // 8 random words
+    [[nodiscard]] __m256i next ( ) noexcept {
+        __m256i const t = _mm256_add_epi32 ( _mm256_add_epi32 ( m_a, m_b ), m_counter );
+        m_counter       = _mm256_add_epi32 ( m_counter, _mm256_set1_epi32 ( 1 ) );
+        m_a             = _mm256_xor_si256 ( m_b, _mm256_srli_epi32 ( m_b, 9 ) );
+        m_b             = _mm256_add_epi32 ( m_c, _mm256_slli_epi32 ( m_c, 3 ) );
+        m_c = _mm256_add_epi32 ( _mm256_or_si256 ( _mm256_slli_epi32 ( m_c, 21 ), _mm256_srli_epi32 ( m_c, 11 ) ), t );
+        return t;
+    }
+
+    // in [ 0, 1 )
+    [[nodiscard]] __m256 uniform ( ) noexcept { return to_float ( _mm256_srli_epi32 ( next ( ), 8 ) ); }
+
+    // in [ lo_, hi_ )
+    [[nodiscard]] __m256 uniform ( __m256 lo_, __m256 hi_ ) noexcept {
+        return _mm256_fmadd_ps ( uniform ( ), _mm256_sub_ps ( hi_, lo_ ), lo_ );
+    }
+
+    // standard normal, Box-Muller, r = sqrt ( -2 log u1 ) with u1 in ( 0, 1 ], the angle uniform in [ -pi / 2, pi / 2 ] and
+    // a random sign on both sine and cosine (polynomials are accurate on that interval), z0_ = r cos, z1_ = r sin.
+    void normal ( __m256 & z0_, __m256 & z1_ ) noexcept {
+        __m256i const w = next ( );
+        __m256 const u1 = to_float ( _mm256_add_epi32 ( _mm256_srli_epi32 ( next ( ), 8 ), _mm256_set1_epi32 ( 1 ) ) );
+        __m256 const r  = _mm256_sqrt_ps ( _mm256_mul_ps ( _mm256_set1_ps ( -2.0f ), _mm256_log_ps ( u1 ) ) );
+        __m256 const x  = _mm256_fmsub_ps ( to_float ( _mm256_srli_epi32 ( w, 8 ) ), _mm256_set1_ps ( 3.14159265f ),
+                                            _mm256_set1_ps ( 1.57079633f ) );
+        __m256 const sign = _mm256_castsi256_ps ( _mm256_slli_epi32 ( w, 31 ) ); // the low bit of w
+        __m256 const x2   = _mm256_mul_ps ( x, x );
+        // sin ( x ) = x ( 1 - x^2 / 3! + x^4 / 5! - ... - x^10 / 11! ), cos ( x ) = 1 - x^2 / 2! + ... + x^12 / 12!
+        __m256 s = _mm256_set1_ps ( -2.50521084e-8f );
+        s        = _mm256_fmadd_ps ( s, x2, _mm256_set1_ps ( 2.75573192e-6f ) );
+        s        = _mm256_fmadd_ps ( s, x2, _mm256_set1_ps ( -1.98412698e-4f ) );
+        s        = _mm256_fmadd_ps ( s, x2, _mm256_set1_ps ( 8.33333333e-3f ) );
+        s        = _mm256_fmadd_ps ( s, x2, _mm256_set1_ps ( -1.66666667e-1f ) );
+        s        = _mm256_fmadd_ps ( _mm256_mul_ps ( s, x2 ), x, x );
+        __m256 c = _mm256_set1_ps ( 2.08767570e-9f );
+        c        = _mm256_fmadd_ps ( c, x2, _mm256_set1_ps ( -2.75573192e-7f ) );
+        c        = _mm256_fmadd_ps ( c, x2, _mm256_set1_ps ( 2.48015873e-5f ) );
+        c        = _mm256_fmadd_ps ( c, x2, _mm256_set1_ps ( -1.38888889e-3f ) );
+        c        = _mm256_fmadd_ps ( c, x2, _mm256_set1_ps ( 4.16666667e-2f ) );
+        c        = _mm256_fmadd_ps ( c, x2, _mm256_set1_ps ( -0.5f ) );
+        c        = _mm256_fmadd_ps ( c, x2, _mm256_set1_ps ( 1.0f ) );
+        z0_      = _mm256_xor_ps ( _mm256_mul_ps ( r, c ), sign );
+        z1_      = _mm256_xor_ps ( _mm256_mul_ps ( r, s ), sign );
+    }
+
+    // standard Gumbel, -log ( -log u ), u in ( 0, 1 )
+    [[nodiscard]] __m256 gumbel ( ) noexcept {
+        __m256 const u = _mm256_fmadd_ps ( _mm256_cvtepi32_ps ( _mm256_srli_epi32 ( next ( ), 8 ) ), _mm256_set1_ps ( 0x1.0p-24f ),
+                                           _mm256_set1_ps ( 0x1.0p-25f ) );
+        return _mm256_sub_ps ( _mm256_setzero_ps ( ),
+                               _mm256_log_ps ( _mm256_sub_ps ( _mm256_setzero_ps ( ), _mm256_log_ps ( u ) ) ) );
+    }
+
+#else
+
+    // 4 random words, of the lanes [ 0, 4 ) and [ 4, 8 ) in turn
+    [[nodiscard]] __m128i next ( ) noexcept {
+        int const h = m_half;
+        m_half ^= 1;
+        return next ( h );
+    }
+
+    [[nodiscard]] __m128 uniform ( ) noexcept { return to_float ( _mm_srli_epi32 ( next ( ), 8 ) ); }
+
+    [[nodiscard]] __m128 uniform ( __m128 lo_, __m128 hi_ ) noexcept {
+        return _mm_add_ps ( _mm_mul_ps ( uniform ( ), _mm_sub_ps ( hi_, lo_ ) ), lo_ );
+    }
+
+    // as above, of the lanes [ 0, 4 ) and [ 4, 8 ) in turn
+    void normal ( __m128 & z0_, __m128 & z1_ ) noexcept {
+        int const h       = m_half;
+        m_half ^= 1;
+        __m128i const w   = next ( h );
+        __m128 const u1   = to_float ( _mm_add_epi32 ( _mm_srli_epi32 ( next ( h ), 8 ), _mm_set1_epi32 ( 1 ) ) );
+        __m128 const r    = _mm_sqrt_ps ( _mm_mul_ps ( _mm_set1_ps ( -2.0f ), log_ps<simd_accuracy::accurate> ( u1 ) ) );
+        __m128 const x    = _mm_sub_ps ( _mm_mul_ps ( to_float ( _mm_srli_epi32 ( w, 8 ) ), _mm_set1_ps ( 3.14159265f ) ),
+                                         _mm_set1_ps ( 1.57079633f ) );
+        __m128 const sign = _mm_castsi128_ps ( _mm_slli_epi32 ( w, 31 ) );
+        __m128 const x2   = _mm_mul_ps ( x, x );
+        __m128 s          = _mm_set1_ps ( -2.50521084e-8f );
+        s                 = o::fmadd ( s, x2, _mm_set1_ps ( 2.75573192e-6f ) );
+        s                 = o::fmadd ( s, x2, _mm_set1_ps ( -1.98412698e-4f ) );
+        s                 = o::fmadd ( s, x2, _mm_set1_ps ( 8.33333333e-3f ) );
+        s                 = o::fmadd ( s, x2, _mm_set1_ps ( -1.66666667e-1f ) );
+        s                 = o::fmadd ( _mm_mul_ps ( s, x2 ), x, x );
+        __m128 c          = _mm_set1_ps ( 2.08767570e-9f );
+        c                 = o::fmadd ( c, x2, _mm_set1_ps ( -2.75573192e-7f ) );
+        c                 = o::fmadd ( c, x2, _mm_set1_ps ( 2.48015873e-5f ) );
+        c                 = o::fmadd ( c, x2, _mm_set1_ps ( -1.38888889e-3f ) );
+        c                 = o::fmadd ( c, x2, _mm_set1_ps ( 4.16666667e-2f ) );
+        c                 = o::fmadd ( c, x2, _mm_set1_ps ( -0.5f ) );
+        c                 = o::fmadd ( c, x2, _mm_set1_ps ( 1.0f ) );
+        z0_               = _mm_xor_ps ( _mm_mul_ps ( r, c ), sign );
+        z1_               = _mm_xor_ps ( _mm_mul_ps ( r, s ), sign );
+    }
+
+    [[nodiscard]] __m128 gumbel ( ) noexcept {
+        __m128 const u = _mm_add_ps ( _mm_mul_ps ( _mm_cvtepi32_ps ( _mm_srli_epi32 ( next ( ), 8 ) ), _mm_set1_ps ( 0x1.0p-24f ) ),
+                                      _mm_set1_ps ( 0x1.0p-25f ) );
+        __m128 const l = _mm_sub_ps ( _mm_setzero_ps ( ), log_ps<simd_accuracy::accurate> ( u ) );
+        return _mm_sub_ps ( _mm_setzero_ps ( ), log_ps<simd_accuracy::accurate> ( l ) );
+    }
+
+#endif
+
+    // bulk, n_ floats at p_ (the tail, up to width - 1 values, is written from a full vector)
+
+    void fill_uniform ( float * p_, std::size_t n_, float lo_, float hi_ ) noexcept {
+        vector_type const lo = o::set1 ( lo_ ), hi = o::set1 ( hi_ );
+        fill ( p_, n_, [ & ] ( ) noexcept { return uniform ( lo, hi ); } );
+    }
+
+    void fill_normal ( float * p_, std::size_t n_, float mean_ = 0.0f, float stddev_ = 1.0f ) noexcept {
+        vector_type const mean = o::set1 ( mean_ ), stddev = o::set1 ( stddev_ );
+        std::size_t i = 0;
+        for ( ; i + 16 <= n_; i += 16 ) {
+            for ( int l = 0; l < 8; l += width ) { // the cosines of the 8 lanes, then the sines
+                vector_type z0, z1;
+                normal ( z0, z1 );
+                o::storeu ( p_ + i + l, o::fmadd ( z0, stddev, mean ) );
+                o::storeu ( p_ + i + 8 + l, o::fmadd ( z1, stddev, mean ) );
+            }
+        }
+        fill ( p_ + i, n_ - i, [ & ] ( ) noexcept {
+            vector_type z0, z1;
+            normal ( z0, z1 );
+            return o::fmadd ( z0, stddev, mean );
+        } );
+    }
+
+    void fill_gumbel ( float * p_, std::size_t n_ ) noexcept {
+        fill ( p_, n_, [ this ] ( ) noexcept { return gumbel ( ); } );
+    }
+
+    private:
+    using o = detail::simd_ops<vector_type>;
+
+#if defined( __AVX2__ )
+    [[nodiscard]] static __m256 to_float ( __m256i x_ ) noexcept { // x_ < 2^24
+        return _mm256_mul_ps ( _mm256_cvtepi32_ps ( x_ ), _mm256_set1_ps ( 0x1.0p-24f ) );
+    }
+#else
+    [[nodiscard]] static __m128 to_float ( __m128i x_ ) noexcept {
+        return _mm_mul_ps ( _mm_cvtepi32_ps ( x_ ), _mm_set1_ps ( 0x1.0p-24f ) );
+    }
+
+    [[nodiscard]] __m128i next ( int h_ ) noexcept {
+        __m128i const t = _mm_add_epi32 ( _mm_add_epi32 ( m_a[ h_ ], m_b[ h_ ] ), m_counter[ h_ ] );
+        m_counter[ h_ ] = _mm_add_epi32 ( m_counter[ h_ ], _mm_set1_epi32 ( 1 ) );
+        m_a[ h_ ]       = _mm_xor_si128 ( m_b[ h_ ], _mm_srli_epi32 ( m_b[ h_ ], 9 ) );
+        m_b[ h_ ]       = _mm_add_epi32 ( m_c[ h_ ], _mm_slli_epi32 ( m_c[ h_ ], 3 ) );
+        m_c[ h_ ] = _mm_add_epi32 ( _mm_or_si128 ( _mm_slli_epi32 ( m_c[ h_ ], 21 ), _mm_srli_epi32 ( m_c[ h_ ], 11 ) ), t );
+        return t;
+    }
+#endif
+
+    template<typename Vector>
+    static void fill ( float * p_, std::size_t n_, Vector vector_ ) noexcept {
+        std::size_t i = 0;
+        for ( ; i + width <= n_; i += width )
+            o::storeu ( p_ + i, vector_ ( ) );
+        if ( i < n_ ) {
+            float tail[ width ];
+            o::storeu ( tail, vector_ ( ) );
+            for ( std::size_t j = 0; i < n_; ++i, ++j )
+                p_[ i ] = tail[ j ];
+        }
+    }
+
+    [[nodiscard]] static constexpr std::uint64_t splitmix64 ( std::uint64_t x_ ) noexcept {
+        x_ = ( x_ ^ ( x_ >> 30 ) ) * 0xBF58'476D'1CE4'E5B9;
+        x_ = ( x_ ^ ( x_ >> 27 ) ) * 0x94D0'49BB'1331'11EB;
+        return x_ ^ ( x_ >> 31 );
+    }
+
+#if defined( __AVX2__ )
+    __m256i m_a, m_b, m_c, m_counter;
+#else
+    __m128i m_a[ 2 ], m_b[ 2 ], m_c[ 2 ], m_counter[ 2 ]; // the lanes [ 0, 4 ) and [ 4, 8 )
+    int m_half = 0;
+#endif
+};
+
+TD_LEARNING_END_TARGET
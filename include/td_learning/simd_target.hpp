@@ -0,0 +1,51 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+// The SIMD target of the including translation unit, from its ISA flags: avx512 (f, dq, bw and vl), avx2 (with fma and
+// f16c), sse41, or sse2 (the x86-64 baseline, of the code that runs before the cpu is checked, see simd_dispatch.hpp).
+// MSVC defines __AVX2__ and __AVX512F__ with /arch, it has no macro of SSE4.1 (it accepts those intrinsics without one).
+//
+// The library lives in an inline namespace of the target (TD_LEARNING_BEGIN_TARGET ... TD_LEARNING_END_TARGET), one
+// program can link the library compiled for several targets (a translation unit each) without breaking the one definition
+// rule, the sse41 code never calls an inline function of the library the linker took from the avx2 translation unit. The
+// inline functions and templates of other libraries (the standard library, mkl, cereal) are still merged, like with any
+// per-file ISA flags.
+
+#if defined( __AVX512F__ )
+#    define TD_LEARNING_TARGET avx512
+#    define TD_LEARNING_TARGET_NAME "avx512"
+#elif defined( __AVX2__ )
+#    define TD_LEARNING_TARGET avx2
+#    define TD_LEARNING_TARGET_NAME "avx2"
+#elif defined( __SSE4_1__ ) or ( defined( _MSC_VER ) and not defined( __clang__ ) )
+#    define TD_LEARNING_TARGET sse41
+#    define TD_LEARNING_TARGET_NAME "sse41"
+#else
+#    define TD_LEARNING_TARGET sse2
+#    define TD_LEARNING_TARGET_NAME "sse2"
+#endif
+
+#define TD_LEARNING_BEGIN_TARGET inline namespace TD_LEARNING_TARGET {
+#define TD_LEARNING_END_TARGET }
@@ -0,0 +1,181 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <immintrin.h>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <bit>
+
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+// State encodings, for (replay) storage of observations. Every encoding stores a state of N floats in bytes bytes,
+// encode ( ) is called once per stored state, decode ( ) once per sampled state (vectorized, 8 floats per step, 4 with
+// SSE4.1). The bytes are the same on every target.
+//
+//   fp32_encoding  - as is, 4 bytes per float.
+//   fp16_encoding  - IEEE half precision (F16C, in software with SSE4.1), 2 bytes per float, relative error < 4.9e-4.
+//   q8_encoding    - affine 8-bit quantization, x ~= offset + scale * q, 1 byte per float plus 8 bytes per state, absolute
+//                    error <= ( max - min ) / 510 per state.
+
+template<int N>
+struct fp32_encoding {
+
+    static constexpr std::size_t bytes = N * sizeof ( float );
+
+    static void encode ( std::byte * dst_, float const * src_ ) noexcept { std::memcpy ( dst_, src_, bytes ); }
+    static void decode ( float * dst_, std::byte const * src_ ) noexcept { std::memcpy ( dst_, src_, bytes ); }
+};
+
+namespace detail {
+
+// round to nearest even, as _cvtss_sh, NaNs quieted keeping the top of the payload, F. Giesen's float_to_half_fast3_rtne
+[[nodiscard]] inline std::uint16_t float_to_half ( float f_ ) noexcept {
+    std::uint32_t u          = std::bit_cast<std::uint32_t> ( f_ );
+    std::uint32_t const sign = u & 0x8000'0000u;
+    u ^= sign;
+    std::uint32_t h;
+    if ( u >= ( 127u + 16u ) << 23 ) // inf or nan
+        h = u > 0x7F80'0000u ? 0x7C00u | 0x0200u | ( ( u & 0x007F'FFFFu ) >> 13 ) : 0x7C00u;
+    else if ( u < 113u << 23 ) { // subnormal or zero, the addition rounds
+        std::uint32_t const magic = ( ( 127u - 15u ) + ( 23u - 10u ) + 1u ) << 23;
+        h = std::bit_cast<std::uint32_t> ( std::bit_cast<float> ( u ) + std::bit_cast<float> ( magic ) ) - magic;
+    }
+    else {
+        u += ( ( 15u - 127u ) << 23 ) + 0x0FFFu + ( ( u >> 13 ) & 1u );
+        h = u >> 13;
+    }
+    return static_cast<std::uint16_t> ( h | ( sign >> 16 ) );
+}
+
+[[nodiscard]] inline float half_to_float ( std::uint16_t h_ ) noexcept {
+    std::uint32_t const sign = static_cast<std::uint32_t> ( h_ & 0x8000u ) << 16, e = ( h_ >> 10 ) & 0x1Fu, m = h_ & 0x03FFu;
+    if ( e == 0x1F ) // inf or nan, quieted
+        return std::bit_cast<float> ( sign | ( m ? 0x7FC0'0000u : 0x7F80'0000u ) | ( m << 13 ) );
+    if ( e == 0 ) // subnormal or zero, exact
+        return std::bit_cast<float> ( sign | std::bit_cast<std::uint32_t> ( static_cast<float> ( m ) * 0x1.0p-24f ) );
+    return std::bit_cast<float> ( sign | ( ( e + 112u ) << 23 ) | ( m << 13 ) );
+}
+
+} // namespace detail
+
+template<int N>
+struct fp16_encoding {
+
+    static constexpr std::size_t bytes = N * sizeof ( std::uint16_t );
+
+#if defined( __AVX2__ )
+
+    static void encode ( std::byte * dst_, float const * src_ ) noexcept {
+        int i = 0;
+        for ( ; i + 8 <= N; i += 8 )
+            _mm_storeu_si128 ( reinterpret_cast<__m128i *> ( dst_ + 2 * i ),
+                               _mm256_cvtps_ph ( _mm256_loadu_ps ( src_ + i ), _MM_FROUND_TO_NEAREST_INT ) );
+        for ( ; i < N; ++i ) {
+            std::uint16_t const h = _cvtss_sh ( src_[ i ], _MM_FROUND_TO_NEAREST_INT );
+            std::memcpy ( dst_ + 2 * i, &h, sizeof ( h ) );
+        }
+    }
+
+    static void decode ( float * dst_, std::byte const * src_ ) noexcept {
+        int i = 0;
+        for ( ; i + 8 <= N; i += 8 )
+            _mm256_storeu_ps ( dst_ + i,
+                               _mm256_cvtph_ps ( _mm_loadu_si128 ( reinterpret_cast<__m128i const *> ( src_ + 2 * i ) ) ) );
+        for ( ; i < N; ++i ) {
+            std::uint16_t h;
+            std::memcpy ( &h, src_ + 2 * i, sizeof ( h ) );
+            dst_[ i ] = _cvtsh_ss ( h );
+        }
+    }
+
+#else
+
+    static void encode ( std::byte * dst_, float const * src_ ) noexcept {
+        for ( int i = 0; i < N; ++i ) {
+            std::uint16_t const h = detail::float_to_half ( src_[ i ] );
+            std::memcpy ( dst_ + 2 * i, &h, sizeof ( h ) );
+        }
+    }
+
+    static void decode ( float * dst_, std::byte const * src_ ) noexcept {
+        for ( int i = 0; i < N; ++i ) {
+            std::uint16_t h;
+            std::memcpy ( &h, src_ + 2 * i, sizeof ( h ) );
+            dst_[ i ] = detail::half_to_float ( h );
+        }
+    }
+
+#endif
+};
+
+template<int N>
+struct q8_encoding {
+
+    static constexpr std::size_t bytes = 2 * sizeof ( float ) + N; // offset, scale, codes
+
+    static void encode ( std::byte * dst_, float const * src_ ) noexcept {
+        auto const [ min, max ] = std::minmax_element ( src_, src_ + N );
+        float const offset = *min, scale = ( *max - *min ) / 255.0f, inverse = scale > 0.0f ? 1.0f / scale : 0.0f;
+        std::memcpy ( dst_, &offset, sizeof ( float ) );
+        std::memcpy ( dst_ + sizeof ( float ), &scale, sizeof ( float ) );
+        auto codes = reinterpret_cast<std::uint8_t *> ( dst_ + 2 * sizeof ( float ) );
+        for ( int i = 0; i < N; ++i )
+            codes[ i ] = static_cast<std::uint8_t> ( std::lround ( ( src_[ i ] - offset ) * inverse ) );
+    }
+
+    static void decode ( float * dst_, std::byte const * src_ ) noexcept {
+        float offset, scale;
+        std::memcpy ( &offset, src_, sizeof ( float ) );
+        std::memcpy ( &scale, src_ + sizeof ( float ), sizeof ( float ) );
+        auto codes     = reinterpret_cast<std::uint8_t const *> ( src_ + 2 * sizeof ( float ) );
+        int i          = 0;
+#if defined( __AVX2__ )
+        __m256 const o = _mm256_set1_ps ( offset ), s = _mm256_set1_ps ( scale );
+        for ( ; i + 8 <= N; i += 8 ) {
+            __m128i const q = _mm_loadl_epi64 ( reinterpret_cast<__m128i const *> ( codes + i ) );
+            _mm256_storeu_ps ( dst_ + i, _mm256_fmadd_ps ( _mm256_cvtepi32_ps ( _mm256_cvtepu8_epi32 ( q ) ), s, o ) );
+        }
+#else
+        __m128 const o = _mm_set1_ps ( offset ), s = _mm_set1_ps ( scale );
+        for ( ; i + 4 <= N; i += 4 ) {
+            std::int32_t q;
+            std::memcpy ( &q, codes + i, sizeof ( q ) );
+            __m128 const x = _mm_cvtepi32_ps ( _mm_cvtepu8_epi32 ( _mm_cvtsi32_si128 ( q ) ) );
+            _mm_storeu_ps ( dst_ + i, _mm_add_ps ( _mm_mul_ps ( x, s ), o ) );
+        }
+#endif
+        for ( ; i < N; ++i )
+            dst_[ i ] = offset + scale * static_cast<float> ( codes[ i ] );
+    }
+};
+
+TD_LEARNING_END_TARGET
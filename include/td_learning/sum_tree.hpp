@@ -0,0 +1,99 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+
+#include <algorithm>
+#include <bit>
+#include <random>
+#include <span>
+#include <vector>
+
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+// sum_tree
+//
+//   A flat (implicit) binary tree of priorities, node i has children 2i and 2i + 1, the leaves start at the first power of 2
+//   not smaller than the capacity. Updates recompute the sums on the path to the root (no drift), O(log n), sampling descends
+//   from the root, O(log n).
+//
+class sum_tree {
+
+    public:
+    using size_type = std::size_t;
+
+    explicit sum_tree ( size_type capacity_ ) : m_leaves ( std::bit_ceil ( capacity_ ) ), m_nodes ( 2 * m_leaves, 0.0f ) {}
+
+    [[nodiscard]] size_type capacity ( ) const noexcept { return m_leaves; }
+
+    [[nodiscard]] float total ( ) const noexcept { return m_nodes[ 1 ]; }
+    [[nodiscard]] float max ( ) const noexcept { return m_max; }
+
+    [[nodiscard]] float operator[] ( size_type i_ ) const noexcept { return m_nodes[ m_leaves + i_ ]; }
+
+    void update ( size_type i_, float priority_ ) noexcept {
+        assert ( i_ < m_leaves and priority_ >= 0.0f );
+        m_max = std::max ( m_max, priority_ );
+        i_ += m_leaves;
+        m_nodes[ i_ ] = priority_;
+        for ( i_ >>= 1; i_; i_ >>= 1 )
+            m_nodes[ i_ ] = m_nodes[ 2 * i_ ] + m_nodes[ 2 * i_ + 1 ];
+    }
+
+    // the leaf in which the cumulative priority mass_ falls, mass_ in [ 0, total ( ) )
+    [[nodiscard]] size_type find ( float mass_ ) const noexcept {
+        size_type i = 1;
+        while ( i < m_leaves ) {
+            float const left = m_nodes[ 2 * i ];
+            bool const right = mass_ >= left and m_nodes[ 2 * i + 1 ] > 0.0f; // rounding could point at an empty subtree
+            mass_ -= right ? left : 0.0f;
+            i = 2 * i + right;
+        }
+        return i - m_leaves;
+    }
+
+    // stratified sampling, one leaf per equal slice of the total mass
+    template<typename Generator>
+    void sample ( std::span<int> leaves_, Generator & rng_ ) const noexcept {
+        std::uniform_real_distribution<float> dis;
+        float const slice = total ( ) / static_cast<float> ( leaves_.size ( ) );
+        float base        = 0.0f;
+        for ( auto & l : leaves_ ) {
+            l = static_cast<int> ( find ( std::min ( base + dis ( rng_ ) * slice, std::nextafter ( total ( ), 0.0f ) ) ) );
+            base += slice;
+        }
+    }
+
+    private:
+    size_type m_leaves;
+    std::vector<float> m_nodes;
+    float m_max = 0.0f;
+};
+
+TD_LEARNING_END_TARGET
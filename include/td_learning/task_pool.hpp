@@ -0,0 +1,349 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined( _WIN32 )
+#    include <windows.h>
+#else
+#    include <pthread.h>
+#    include <sched.h>
+#endif
+
+#include "td_learning/rng.hpp"
+#include "td_learning/thread_id.hpp"
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+namespace detail {
+
+// Chase-Lev work-stealing deque (fixed capacity), the owner pushes and pops at the bottom, thieves steal from the top.
+template<typename T>
+class work_stealing_deque {
+
+    public:
+    explicit work_stealing_deque ( int capacity_ ) :
+        m_mask ( static_cast<std::int64_t> ( std::bit_ceil ( static_cast<unsigned> ( capacity_ ) ) ) - 1 ),
+        m_data ( std::make_unique<std::atomic<T *>[]> ( m_mask + 1 ) ) {}
+
+    // owner, returns false if full
+    [[nodiscard]] bool push ( T * value_ ) noexcept {
+        std::int64_t const b = m_bottom.load ( std::memory_order_relaxed ), t = m_top.load ( std::memory_order_acquire );
+        if ( b - t > m_mask )
+            return false;
+        m_data[ b & m_mask ].store ( value_, std::memory_order_relaxed );
+        std::atomic_thread_fence ( std::memory_order_release );
+        m_bottom.store ( b + 1, std::memory_order_relaxed );
+        return true;
+    }
+
+    // owner
+    [[nodiscard]] T * pop ( ) noexcept {
+        std::int64_t const b = m_bottom.load ( std::memory_order_relaxed ) - 1;
+        m_bottom.store ( b, std::memory_order_relaxed );
+        std::atomic_thread_fence ( std::memory_order_seq_cst );
+        std::int64_t t = m_top.load ( std::memory_order_relaxed );
+        if ( t > b ) { // empty
+            m_bottom.store ( b + 1, std::memory_order_relaxed );
+            return nullptr;
+        }
+        T * value = m_data[ b & m_mask ].load ( std::memory_order_relaxed );
+        if ( t == b ) { // last one, race the thieves
+            if ( not m_top.compare_exchange_strong ( t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed ) )
+                value = nullptr;
+            m_bottom.store ( b + 1, std::memory_order_relaxed );
+        }
+        return value;
+    }
+
+    // any thread
+    [[nodiscard]] T * steal ( ) noexcept {
+        std::int64_t t = m_top.load ( std::memory_order_acquire );
+        std::atomic_thread_fence ( std::memory_order_seq_cst );
+        std::int64_t const b = m_bottom.load ( std::memory_order_acquire );
+        if ( t >= b )
+            return nullptr;
+        T * value = m_data[ t & m_mask ].load ( std::memory_order_relaxed );
+        if ( not m_top.compare_exchange_strong ( t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed ) )
+            return nullptr; // lost the race
+        return value;
+    }
+
+    private:
+    std::int64_t const m_mask;
+    std::unique_ptr<std::atomic<T *>[]> m_data;
+
+    alignas ( 64 ) std::atomic<std::int64_t> m_top    = 0;
+    alignas ( 64 ) std::atomic<std::int64_t> m_bottom = 0;
+};
+
+inline void pin_to_core ( std::thread::native_handle_type handle_, int core_ ) noexcept {
+#if defined( _WIN32 )
+    SetThreadAffinityMask ( handle_, DWORD_PTR{ 1 } << core_ );
+#else
+    cpu_set_t set;
+    CPU_ZERO ( &set );
+    CPU_SET ( core_, &set );
+    pthread_setaffinity_np ( handle_, sizeof ( cpu_set_t ), &set );
+#endif
+}
+
+} // namespace detail
+
+// task_pool
+//
+//   A work-stealing thread pool, one worker per core (pinned). Every worker owns a Chase-Lev deque, tasks submitted from a
+//   worker go to the bottom of its own deque, tasks submitted from outside go into a shared injection queue. Idle workers
+//   steal from the top of a random victim's deque. Workers register with ThreadID on start-up (and free their id on exit),
+//   so per_thread scratch space and Rng::generator ( ) are set up before the first task runs. The workers are capped at the
+//   ThreadIDs available on construction.
+//
+//   Use a task_group to wait for a set of tasks, waiting threads (workers or not) execute pending tasks in the meantime.
+//   Tasks submitted directly should not throw (an exception escaping a task on a worker terminates), task_group hands the
+//   exceptions of its tasks to wait ( ).
+//
+class task_pool {
+
+    using task_type = std::function<void ( )>;
+
+    public:
+    explicit task_pool ( int workers_ = static_cast<int> ( std::thread::hardware_concurrency ( ) ), int deque_capacity_ = 4'096,
+                         bool pin_ = true ) {
+        workers_        = std::clamp ( workers_, 1, std::max ( 1, ThreadID::available ( ) ) ); // every worker takes an id
+        int const cores = std::max ( 1, static_cast<int> ( std::thread::hardware_concurrency ( ) ) );
+        for ( int w = 0; w < workers_; ++w )
+            m_deques.emplace_back ( std::make_unique<detail::work_stealing_deque<task_type>> ( deque_capacity_ ) );
+        for ( int w = 0; w < workers_; ++w ) {
+            m_workers.emplace_back ( [ this, w ] ( std::stop_token stop_ ) noexcept { work ( stop_, w ); } );
+            if ( pin_ )
+                detail::pin_to_core ( m_workers.back ( ).native_handle ( ), w % cores );
+        }
+    }
+
+    task_pool ( task_pool const & ) = delete;
+    task_pool & operator= ( task_pool const & ) = delete;
+
+    ~task_pool ( ) noexcept {
+        for ( auto & w : m_workers )
+            w.request_stop ( );
+        m_pending.fetch_add ( 1, std::memory_order_release ); // wake up the sleepers
+        m_pending.notify_all ( );
+        m_workers.clear ( ); // joins
+        for ( auto & d : m_deques )
+            for ( task_type * t; ( t = d->pop ( ) ); )
+                delete t;
+        for ( task_type * t; ( t = pop_injected ( ) ); )
+            delete t;
+    }
+
+    [[nodiscard]] int size ( ) const noexcept { return static_cast<int> ( m_workers.size ( ) ); }
+
+    // index of the calling worker in [ 0, size ( ) ), or -1 if the caller is not a worker of this pool
+    [[nodiscard]] int worker_index ( ) const noexcept { return this == tl_pool ? tl_worker : -1; }
+
+    template<typename Function>
+    void submit ( Function && function_ ) {
+        auto t = new task_type ( std::forward<Function> ( function_ ) );
+        int const w = worker_index ( );
+        if ( w < 0 or not m_deques[ w ]->push ( t ) ) {
+            std::scoped_lock lock ( m_injection_mutex );
+            m_injection.push_back ( t );
+        }
+        m_pending.fetch_add ( 1, std::memory_order_release );
+        m_pending.notify_one ( );
+    }
+
+    // executes one pending task (if any) on the calling thread, returns false if none was found
+    bool run_pending_task ( ) {
+        int const w = worker_index ( );
+        task_type * t = w < 0 ? nullptr : m_deques[ w ]->pop ( );
+        if ( not t )
+            t = pop_injected ( );
+        if ( not t )
+            t = steal ( w );
+        if ( not t )
+            return false;
+        m_pending.fetch_sub ( 1, std::memory_order_relaxed );
+        std::unique_ptr<task_type> const task ( t );
+        ( *task ) ( );
+        return true;
+    }
+
+    private:
+    [[nodiscard]] task_type * pop_injected ( ) noexcept {
+        std::scoped_lock lock ( m_injection_mutex );
+        if ( m_injection.empty ( ) )
+            return nullptr;
+        task_type * t = m_injection.front ( );
+        m_injection.pop_front ( );
+        return t;
+    }
+
+    [[nodiscard]] task_type * steal ( int thief_ ) noexcept {
+        int const n = size ( );
+        int const start = std::uniform_int_distribution<int> ( 0, n - 1 ) ( Rng::generator ( ) );
+        for ( int i = 0; i < n; ++i ) {
+            int const victim = ( start + i ) % n;
+            if ( victim != thief_ )
+                if ( task_type * t = m_deques[ victim ]->steal ( ) )
+                    return t;
+        }
+        return nullptr;
+    }
+
+    void work ( std::stop_token stop_, int index_ ) noexcept {
+        tl_pool   = this;
+        tl_worker = index_;
+        [[maybe_unused]] int const id = ThreadID::get ( );
+        while ( not stop_.stop_requested ( ) ) {
+            if ( run_pending_task ( ) )
+                continue;
+            int const pending = m_pending.load ( std::memory_order_acquire );
+            if ( pending > 0 ) { // a task is in flight (being pushed, or lost to a steal race)
+                std::this_thread::yield ( );
+                continue;
+            }
+            m_pending.wait ( pending, std::memory_order_acquire );
+        }
+    }
+
+    std::vector<std::unique_ptr<detail::work_stealing_deque<task_type>>> m_deques;
+    std::deque<task_type *> m_injection;
+    std::mutex m_injection_mutex;
+
+    alignas ( 64 ) std::atomic<int> m_pending = 0;
+
+    std::vector<std::jthread> m_workers;
+
+    static thread_local task_pool * tl_pool;
+    static thread_local int tl_worker;
+};
+
+inline thread_local task_pool * task_pool::tl_pool = nullptr;
+inline thread_local int task_pool::tl_worker       = -1;
+
+// task_group
+//
+//   Counts the tasks it submits, wait ( ) helps executing tasks until all of them have completed. A task that throws does
+//   not take the pool down, the first exception is rethrown by wait ( ) and the tasks of the group that have not started
+//   yet are skipped. The destructor waits, but drops the exception (call wait ( ) to see it).
+//
+class task_group {
+
+    public:
+    explicit task_group ( task_pool & pool_ ) noexcept : m_pool ( pool_ ) {}
+
+    task_group ( task_group const & ) = delete;
+    task_group & operator= ( task_group const & ) = delete;
+
+    ~task_group ( ) noexcept { drain ( ); }
+
+    template<typename Function>
+    void run ( Function && function_ ) {
+        m_count.fetch_add ( 1, std::memory_order_relaxed );
+        try {
+            m_pool.submit ( [ this, f = std::forward<Function> ( function_ ) ] ( ) mutable noexcept {
+                struct done {
+                    std::atomic<int> & count;
+                    ~done ( ) { count.fetch_sub ( 1, std::memory_order_release ); }
+                } const guard{ m_count };
+                if ( m_cancelled.load ( std::memory_order_relaxed ) )
+                    return;
+                try {
+                    f ( );
+                }
+                catch ( ... ) {
+                    fail ( std::current_exception ( ) );
+                }
+            } );
+        }
+        catch ( ... ) { // not submitted
+            m_count.fetch_sub ( 1, std::memory_order_relaxed );
+            throw;
+        }
+    }
+
+    void wait ( ) {
+        drain ( );
+        std::exception_ptr error;
+        {
+            std::scoped_lock lock ( m_error_mutex );
+            error = std::exchange ( m_error, nullptr );
+            m_cancelled.store ( false, std::memory_order_relaxed );
+        }
+        if ( error )
+            std::rethrow_exception ( error );
+    }
+
+    private:
+    void drain ( ) noexcept { // the tasks of task_groups don't throw, see task_pool on the others
+        while ( m_count.load ( std::memory_order_acquire ) )
+            if ( not m_pool.run_pending_task ( ) )
+                std::this_thread::yield ( );
+    }
+
+    void fail ( std::exception_ptr error_ ) noexcept {
+        std::scoped_lock lock ( m_error_mutex );
+        if ( not m_error )
+            m_error = std::move ( error_ );
+        m_cancelled.store ( true, std::memory_order_relaxed );
+    }
+
+    task_pool & m_pool;
+    alignas ( 64 ) std::atomic<int> m_count = 0;
+    std::atomic<bool> m_cancelled           = false;
+    std::mutex m_error_mutex;
+    std::exception_ptr m_error;
+};
+
+// Calls function_ ( i ) for all i in [ first_, last_ ), in chunks of grain_ indices.
+template<typename Function>
+void parallel_for ( task_pool & pool_, int first_, int last_, Function const & function_, int grain_ = 1 ) {
+    task_group group ( pool_ );
+    for ( int b = first_; b < last_; b += grain_ )
+        group.run ( [ &function_, b, e = std::min ( b + grain_, last_ ) ] ( ) {
+            for ( int i = b; i < e; ++i )
+                function_ ( i );
+        } );
+    group.wait ( );
+}
+
+TD_LEARNING_END_TARGET
@@ -0,0 +1,87 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include <atomic>
+#include <bit>
+
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+#if not defined( TD_LEARNING_MAX_THREADS )
+#    define TD_LEARNING_MAX_THREADS 1'024
+#endif
+
+namespace ThreadID {
+// The ids are in [ 0, max_threads ), the ids of exited threads are reused.
+inline constexpr int max_threads = TD_LEARNING_MAX_THREADS;
+
+static_assert ( max_threads > 0 and max_threads % 64 == 0, "TD_LEARNING_MAX_THREADS should be a multiple of 64" );
+
+namespace detail {
+inline std::atomic<std::uint64_t> slots[ max_threads / 64 ]; // a set bit is a taken id
+
+// Takes the lowest free ID (no more than max_threads threads can hold one at the same time).
+[[nodiscard]] inline int take ( ) noexcept {
+    for ( int w = 0; w < max_threads / 64; ++w ) {
+        std::uint64_t taken = slots[ w ].load ( std::memory_order_relaxed );
+        while ( ~taken ) {
+            std::uint64_t const bit = ~taken & ( taken + 1 ); // lowest clear bit
+            if ( slots[ w ].compare_exchange_weak ( taken, taken | bit, std::memory_order_acquire, std::memory_order_relaxed ) )
+                return 64 * w + std::countr_zero ( bit );
+        }
+    }
+    std::fprintf ( stderr, "ThreadID: more than %d threads, raise TD_LEARNING_MAX_THREADS\n", max_threads );
+    std::abort ( );
+}
+// Frees an ID.
+inline void release ( int id_ ) noexcept {
+    slots[ id_ / 64 ].fetch_and ( ~( std::uint64_t{ 1 } << ( id_ % 64 ) ), std::memory_order_release );
+}
+} // namespace detail
+
+// The number of IDs not taken (at the moment of the call), f.e. to size a pool of threads.
+[[nodiscard]] inline int available ( ) noexcept {
+    int n = max_threads;
+    for ( auto const & w : detail::slots )
+        n -= std::popcount ( w.load ( std::memory_order_relaxed ) );
+    return n;
+}
+// Returns ID of this thread (taken on the first call, freed when the thread exits).
+[[nodiscard]] inline int get ( ) noexcept {
+    static thread_local struct slot {
+        int const id = detail::take ( );
+        ~slot ( ) { detail::release ( id ); }
+    } thread_local_slot;
+    return thread_local_slot.id;
+}
+
+} // namespace ThreadID
+
+TD_LEARNING_END_TARGET
@@ -0,0 +1,97 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <atomic>
+#include <new>
+
+#include "td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+// triple_buffer
+//
+//   Single-writer, single-reader, lock-free publication of a value (f.e. a 'cascade_network::wgt_type'). The writer fills
+//   back_buffer ( ) and publishes it with one exchange, the reader calls acquire ( ), which costs one acquire load unless a
+//   new snapshot has been published since the last call (in which case it exchanges its front buffer with the middle one).
+//   The buffer returned by acquire ( ) stays valid and unmodified until the next call to acquire ( ) on the reader side,
+//   the writer never touches it. One triple_buffer per reader thread (the trainer publishes to each).
+//
+template<typename T>
+class triple_buffer {
+
+    static constexpr int dirty_bit = 4, index_mask = 3;
+
+    struct alignas ( 64 ) buffer_type { // no false sharing between the three buffers
+        T value;
+    };
+
+    public:
+    using value_type = T;
+
+    triple_buffer ( ) noexcept = default;
+    explicit triple_buffer ( T const & value_ ) noexcept {
+        for ( auto & b : buffers )
+            b.value = value_;
+    }
+
+    triple_buffer ( triple_buffer const & ) = delete;
+    triple_buffer & operator= ( triple_buffer const & ) = delete;
+
+    // writer side
+
+    [[nodiscard]] T & back_buffer ( ) noexcept { return buffers[ back ].value; }
+
+    // makes the back buffer the latest snapshot, the writer continues in a recycled buffer
+    void publish ( ) noexcept { back = middle.exchange ( back | dirty_bit, std::memory_order_acq_rel ) & index_mask; }
+
+    void publish ( T const & value_ ) noexcept {
+        back_buffer ( ) = value_;
+        publish ( );
+    }
+
+    // reader side
+
+    [[nodiscard]] T const & acquire ( ) noexcept {
+        if ( middle.load ( std::memory_order_acquire ) & dirty_bit )
+            front = middle.exchange ( front, std::memory_order_acq_rel ) & index_mask;
+        return buffers[ front ].value;
+    }
+
+    // the snapshot returned by the last call to acquire ( )
+    [[nodiscard]] T const & front_buffer ( ) const noexcept { return buffers[ front ].value; }
+
+    private:
+    std::array<buffer_type, 3> buffers;
+
+    alignas ( 64 ) std::atomic<int> middle = 1; // index | dirty_bit
+    alignas ( 64 ) int back                = 0; // writer owned
+    alignas ( 64 ) int front               = 2; // reader owned
+};
+
+TD_LEARNING_END_TARGET
@@ -21,29 +21,10 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
-#include <cassert>
-#include <cstddef>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 
-#include <array>
-#include <atomic>
-#include <algorithm>
-#include <sax/iostream.hpp>
-#include <limits>
-#include <memory>
-#include <mutex>
-#include <new>
-#include <random>
-#include <span>
-#include <stdexcept>
-#include <string>
-#include <thread>
-#include <jthread>
-#include <type_traits>
-#include <utility>
-#include <vector>
-
 /*
     -fsanitize = address
 
@@ -54,65 +35,46 @@
     C:\Program Files (x86)\IntelSWTools\compilers_and_libraries\windows\tbb\lib\intel64_win\vc_mt\tbb.lib
 */
 
-#include <sax/prng_sfc.hpp>
-#include <sax/uniform_int_distribution.hpp>
-
-#if defined( NDEBUG )
-#    define RANDOM 1
-#else
-#    define RANDOM 0
-#endif
-
-namespace ThreadID {
-// Creates a new ID.
-[[nodiscard]] inline int get ( bool ) noexcept {
-    static std::atomic<int> global_id = 0;
-    return global_id++;
-}
-// Returns ID of this thread.
-[[nodiscard]] inline int get ( ) noexcept {
-    static thread_local int thread_local_id = get ( false );
-    return thread_local_id;
-}
-
-} // namespace ThreadID
-
-namespace Rng {
-// Chris Doty-Humphrey's Small Fast Chaotic Prng.
-[[nodiscard]] inline sax::Rng & generator ( ) noexcept {
-    if constexpr ( RANDOM ) {
-        static thread_local sax::Rng generator ( sax::os_seed ( ), sax::os_seed ( ), sax::os_seed ( ), sax::os_seed ( ) );
-        return generator;
-    }
-    else {
-        static thread_local sax::Rng generator ( sax::fixed_seed ( ) + ThreadID::get ( ) );
-        return generator;
-    }
-}
-
-} // namespace Rng
-
-#undef RANDOM
+#include "include/td_learning/cpu_features.hpp"
+#include "include/td_learning/simd_dispatch.hpp"
 
-sax::Rng & rng = Rng::generator ( );
+// Compiled without ISA flags (the x86-64 baseline), the program is in src/program_<target>.cpp (see simd_dispatch.hpp).
 
 inline std::uint32_t pointer_alignment ( const void * p_ ) noexcept {
     return ( uint32_t ) ( ( uintptr_t ) p_ & ( uintptr_t ) - ( ( intptr_t ) p_ ) );
 }
 
-#include "include/cascade_network.hpp"
-#include "include/td_learning.hpp"
-// __m128i _mm_minpos_epu16( __m128i packed_words);
-int main ( ) { 
-    
-    cascade_network<2, 1, 3, 5> fccn ( rng ); 
-
-    std::cout << fccn.NumWeights << nl;
+namespace {
+// runs before the other static initializers, those of the program's translation units are compiled for their target, on a
+// cpu below the minimum they would fault before main ( ) is reached
+struct baseline_check {
+    baseline_check ( ) {
+        if ( not cpu_features::detect ( ).meets_baseline ( ) ) {
+            std::fputs ( "this cpu lacks sse4.1, the minimum the program is built for\n", stderr );
+            std::exit ( EXIT_FAILURE );
+        }
+    }
+};
+#if defined( _MSC_VER ) and not defined( __clang__ )
+#    pragma warning( disable : 4073 )
+#    pragma init_seg( lib )
+baseline_check const check;
+#else
+baseline_check const check __attribute__ ( ( init_priority ( 101 ) ) );
+#endif
+} // namespace
 
-    fccn.feed_forward ( );
-    
-    return EXIT_SUCCESS; 
+namespace sse41 {
+int run ( );
+}
+namespace avx2 {
+int run ( );
 }
+namespace avx512 {
+int run ( );
+}
+
+int main ( ) { return dispatch ( sse41::run, avx2::run, avx512::run ) ( ); }
 
 #if 0
 
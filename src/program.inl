@@ -0,0 +1,106 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// The program, src/program_<target>.cpp compile it once per target (see simd_dispatch.hpp), main.cpp calls the run ( )
+// of the target of the running cpu.
+
+#include <cstdlib>
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <sax/iostream.hpp>
+#include <span>
+#include <thread>
+
+#include "../include/actor_learner.hpp"
+#include "../include/cascade_network.hpp"
+#include "../include/q_learning.hpp"
+#include "../include/replay_buffer.hpp"
+#include "../include/td_learning/rng.hpp"
+#include "../include/td_learning/simd_target.hpp"
+
+TD_LEARNING_BEGIN_TARGET
+
+// A corridor of NumCells cells, episodes start in the middle and end at either end, moving right (action 1) onto the
+// right end pays 1, everything else 0. The observation is the one-hot position.
+struct corridor {
+
+    static constexpr int NumCells = 8;
+
+    template<typename Generator>
+    void reset ( Generator & ) noexcept {
+        m_position = NumCells / 2;
+    }
+    void observe ( span_ps observation_ ) const noexcept {
+        std::fill ( std::begin ( observation_ ), std::end ( observation_ ), 0.0f );
+        observation_[ m_position ] = 1.0f;
+    }
+    template<typename Generator>
+    [[nodiscard]] float step ( int action_, Generator & ) noexcept {
+        m_position += action_ ? 1 : -1;
+        return m_position == NumCells - 1 ? 1.0f : 0.0f;
+    }
+    [[nodiscard]] bool terminal ( ) const noexcept { return not m_position or m_position == NumCells - 1; }
+
+    private:
+    int m_position = NumCells / 2;
+};
+
+int run ( ) {
+
+    sax::Rng & rng = Rng::generator ( );
+
+    using network         = cascade_network<corridor::NumCells, 1, 2, 16, activation::rectifier, activation::identity>;
+    using transition_type = transition<network::NumRaw>;
+
+    network master ( rng );
+    replay_buffer<network::NumRaw> replay ( { .capacity = 65'536 } );
+    q_learner<network> learner ( master, { .batch_size = 32, .gamma = 0.9f, .learning_rate = 0.01f } );
+    replay_batch<network::NumRaw> sample ( 32 );
+
+    // called by the learner threads, serialized
+    auto update = [ & ] ( network &, std::span<transition_type const> transitions_ ) {
+        replay.push ( transitions_ );
+        replay.sample_uniform ( sample );
+        learner.update ( sample );
+    };
+
+    actor_learner<network, corridor, decltype ( update )> pipeline ( master, corridor{ }, update,
+                                                                     { .actors = 4, .learners = 2 } );
+    pipeline.start ( );
+    std::this_thread::sleep_for ( std::chrono::seconds ( 2 ) );
+    pipeline.stop ( );
+
+    std::cout << pipeline.steps ( ) << " steps, " << pipeline.updates ( ) << " updates" << nl;
+
+    corridor ( ).observe ( master.space.raw ( ) );
+    master.feed_forward ( );
+    std::cout << "Q ( start, left ) " << master.space.out ( )[ 0 ] << ", Q ( start, right ) " << master.space.out ( )[ 1 ]
+              << nl;
+
+    return EXIT_SUCCESS;
+}
+
+TD_LEARNING_END_TARGET
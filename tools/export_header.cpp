@@ -0,0 +1,120 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Writes the evaluator header of a model image (see model_file.hpp), the activations (relu by default) are named as in
+// activation.hpp, the image does not record them:
+//
+//     export_header model.tdm evaluator > evaluator.hpp
+//     export_header --hidden=tanh --output=softmax model.tdm evaluator > evaluator.hpp
+//     export_header --hidden=parametric_relu:0.2 model.tdm evaluator > evaluator.hpp
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include <charconv>
+#include <exception>
+#include <optional>
+#include <sax/iostream.hpp>
+#include <string_view>
+
+#include "include/cascade_network.hpp"
+#include "include/export_header.hpp"
+#include "include/model_file.hpp"
+
+template<typename... Activations>
+[[nodiscard]] std::optional<exported_activation> find_activation ( std::string_view name_ ) {
+    std::optional<exported_activation> a;
+    ( ( name_ == Activations::name ? ( void ) ( a = export_activation<Activations> ( ) ) : ( void ) 0 ), ... );
+    return a;
+}
+
+// parametric_relu takes its alpha after a colon, f.e. parametric_relu:0.2
+[[nodiscard]] std::optional<exported_activation> find_activation ( std::string_view name_ ) {
+    namespace a = activation;
+    if ( std::string_view const prefix = a::parametric_rectifier<0.0f>::name; name_.starts_with ( prefix ) ) {
+        std::string_view const value = name_.substr ( prefix.size ( ) );
+        float alpha                  = 0.0f;
+        if ( value.size ( ) < 2 or value[ 0 ] != ':' or
+             std::from_chars ( value.data ( ) + 1, value.data ( ) + value.size ( ), alpha ).ptr != value.data ( ) + value.size ( ) )
+            return { };
+        return exported_activation{ a::parametric_rectifier_source ( alpha ), false, true };
+    }
+    return find_activation<a::identity, a::rectifier, a::leaky_rectifier, a::elliott, a::logistic, a::tanh, a::softmax> ( name_ );
+}
+
+// the number of weights of a network of shape_ (see cascade_network::NumWeights), 0 if no network has that shape
+[[nodiscard]] std::uint64_t weight_count ( std::array<std::int32_t, 4> const & shape_ ) noexcept {
+    auto const [ num_input, num_ones, num_output, num_neurons ] = shape_;
+    if ( num_input < 1 or num_ones < 0 or num_output < 1 or num_neurons < num_output )
+        return 0;
+    std::uint64_t const n = static_cast<std::uint64_t> ( num_neurons );
+    return n * static_cast<std::uint64_t> ( num_input + num_ones ) + ( n - 1 ) * n / 2;
+}
+
+int main ( int argc_, char ** argv_ ) {
+
+    std::optional<exported_activation> hidden = export_activation<activation::rectifier> ( ), output = hidden;
+    for ( ; argc_ > 1 and std::string_view ( argv_[ 1 ] ).starts_with ( "--" ); --argc_, ++argv_ ) {
+        std::string_view const arg = argv_[ 1 ];
+        if ( arg.starts_with ( "--hidden=" ) )
+            hidden = find_activation ( arg.substr ( 9 ) );
+        else if ( arg.starts_with ( "--output=" ) )
+            output = find_activation ( arg.substr ( 9 ) );
+        else
+            hidden.reset ( );
+        if ( not hidden or not output or hidden->is_layer )
+            break;
+    }
+
+    if ( argc_ != 3 or not hidden or not output or hidden->is_layer ) {
+        std::cerr << "usage: export_header [--hidden=NAME] [--output=NAME] <model image> <namespace>" << nl;
+        std::cerr << "       NAME is identity, relu, leaky_relu, parametric_relu:ALPHA, elliott, logistic, tanh or softmax"
+                  << " (output only)" << nl;
+        return EXIT_FAILURE;
+    }
+
+    try {
+        mapped_file const file ( argv_[ 1 ], mapped_file::access::read_only );
+        detail::model_image_header h;
+        if ( file.size ( ) < sizeof ( h ) )
+            throw std::runtime_error ( "not a model image" );
+        std::memcpy ( &h, file.data ( ), sizeof ( h ) );
+        if ( std::memcmp ( h.magic, detail::model_image_magic, sizeof ( h.magic ) ) or h.version != detail::model_image_version or
+             h.byte_order != detail::model_image_byte_order or file.size ( ) < sizeof ( h ) + h.weights * sizeof ( float ) )
+            throw std::runtime_error ( "not a model image (of this version and byte order)" );
+        std::array<std::int32_t, 4> shape;
+        std::memcpy ( shape.data ( ), h.shape, sizeof ( h.shape ) );
+        if ( h.weights != weight_count ( shape ) )
+            throw std::runtime_error ( "the weight count does not match the shape" );
+        // alpha is the same for all shapes
+        export_header ( std::cout, argv_[ 2 ], shape, reinterpret_cast<float const *> ( file.data ( ) + sizeof ( h ) ),
+                        cascade_network<1, 1, 1, 1>::alpha, *hidden, *output );
+    }
+    catch ( std::exception const & e ) {
+        std::cerr << "export_header: " << argv_[ 1 ] << ": " << e.what ( ) << nl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}